@@ -0,0 +1,525 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "allocator.h"
+#include "report.h"
+
+/* The size of the chunks of bump and pool allocators */
+#define ALLOC_CHUNK (64 << 10)
+
+/* The alignment of blocks from chunks */
+#define ALLOC_ALIGN 16
+
+/* Round `size` up to the alignment, taking at least one unit */
+static size_t align_up(size_t size)
+{
+    return (size) ? (size + ALLOC_ALIGN - 1) & ~(size_t) (ALLOC_ALIGN - 1)
+                  : ALLOC_ALIGN;
+}
+
+/* System allocator */
+
+static void *system_alloc(allocator_t *a, size_t size)
+{
+    return malloc(size);
+}
+
+static void system_release(allocator_t *a, void *p, size_t size)
+{
+    free(p);
+}
+
+static void system_destroy(allocator_t *a) {}
+
+static allocator_t system_allocator = {
+    .name = "system",
+    .alloc = system_alloc,
+    .release = system_release,
+    .destroy = system_destroy,
+};
+
+allocator_t *alloc_system()
+{
+    return &system_allocator;
+}
+
+/* Bump allocator */
+
+/* Blocks larger than this are taken from the C library */
+#define BUMP_MAX 4096
+
+/*
+ * Chunk aligned to its size, so that a block finds it by masking its
+ * address.  The chunk being filled counts as one more block in use.
+ */
+typedef struct BUMPCHUNK {
+    struct BUMPCHUNK *prev, *next; /* Chunks of the allocator */
+    size_t live;                   /* Blocks in use */
+} __attribute__((aligned(ALLOC_ALIGN))) bump_chunk_t;
+
+typedef struct {
+    allocator_t ops;
+    bump_chunk_t *chunks; /* All chunks, the one being filled first */
+    size_t used;          /* The bytes taken in the first chunk */
+} bump_t;
+
+/*
+ * Map a chunk aligned to its size, cut out of a mapping twice as large.
+ * The heap of the C library is left alone, since carving aligned chunks out
+ * of it gets slow once it holds many small free blocks.
+ * Return NULL if could not allocate space.
+ */
+static bump_chunk_t *bump_chunk_new()
+{
+    char *const raw = mmap(NULL, 2 * ALLOC_CHUNK, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char *map;
+
+    if (raw == MAP_FAILED)
+        return NULL;
+    map = (char *) (((uintptr_t) raw + ALLOC_CHUNK - 1) &
+                    ~(uintptr_t) (ALLOC_CHUNK - 1));
+    if (map != raw)
+        munmap(raw, map - raw);
+    munmap(map + ALLOC_CHUNK, raw + ALLOC_CHUNK - map);
+    return (bump_chunk_t *) map;
+}
+
+/* Drop a block in use of `chunk`, freeing the chunk if it was the last */
+static void bump_put(bump_t *b, bump_chunk_t *chunk)
+{
+    if (--chunk->live)
+        return;
+    if (chunk->prev)
+        chunk->prev->next = chunk->next;
+    else
+        b->chunks = chunk->next;
+    if (chunk->next)
+        chunk->next->prev = chunk->prev;
+    munmap(chunk, ALLOC_CHUNK);
+}
+
+static void *bump_alloc(allocator_t *a, size_t size)
+{
+    bump_t *const b = (bump_t *) a;
+    bump_chunk_t *chunk = b->chunks;
+    void *p;
+
+    size = align_up(size);
+    if (size > BUMP_MAX)
+        return malloc(size);
+    if (!chunk || ALLOC_CHUNK - b->used < size) {
+        chunk = bump_chunk_new();
+        if (!chunk)
+            return NULL;
+        chunk->prev = NULL;
+        chunk->next = b->chunks;
+        chunk->live = 1;
+        if (b->chunks) {
+            b->chunks->prev = chunk;
+            b->chunks = chunk;
+            bump_put(b, chunk->next);
+        } else {
+            b->chunks = chunk;
+        }
+        b->used = sizeof(bump_chunk_t);
+    }
+    p = (char *) chunk + b->used;
+    b->used += size;
+    ++chunk->live;
+    return p;
+}
+
+static void bump_release(allocator_t *a, void *p, size_t size)
+{
+    if (align_up(size) > BUMP_MAX) {
+        free(p);
+        return;
+    }
+
+    const uintptr_t chunk = (uintptr_t) p & ~(uintptr_t) (ALLOC_CHUNK - 1);
+
+    bump_put((bump_t *) a, (bump_chunk_t *) chunk);
+}
+
+static void bump_destroy(allocator_t *a)
+{
+    bump_t *const b = (bump_t *) a;
+
+    for (bump_chunk_t *c = b->chunks; c;) {
+        bump_chunk_t *const next = c->next;
+        munmap(c, ALLOC_CHUNK);
+        c = next;
+    }
+    free(b);
+}
+
+allocator_t *alloc_bump_new()
+{
+    bump_t *const b = malloc(sizeof(bump_t));
+
+    if (!b)
+        return NULL;
+    b->ops = (allocator_t){
+        .name = "bump",
+        .alloc = bump_alloc,
+        .release = bump_release,
+        .destroy = bump_destroy,
+    };
+    b->chunks = NULL;
+    b->used = 0;
+    return &b->ops;
+}
+
+/* Pool allocator */
+
+/* The number of size classes, the largest of which holds 256 bytes */
+#define POOL_CLASSES 16
+
+/* Free block of a pool */
+typedef struct POOLBLOCK {
+    struct POOLBLOCK *next;
+} pool_block_t;
+
+/* Chunk of a pool, whose blocks start after the header */
+typedef struct POOLCHUNK {
+    struct POOLCHUNK *next;
+} __attribute__((aligned(ALLOC_ALIGN))) pool_chunk_t;
+
+typedef struct {
+    allocator_t ops;
+    pool_block_t *free_lists[POOL_CLASSES]; /* Free blocks of each class */
+    pool_chunk_t *chunks; /* All chunks, the one being carved first */
+    size_t used;          /* The bytes taken in the first chunk */
+} pool_t;
+
+static void *pool_alloc(allocator_t *a, size_t size)
+{
+    pool_t *const pl = (pool_t *) a;
+    pool_block_t *p;
+
+    size = align_up(size);
+    if (size > POOL_CLASSES * ALLOC_ALIGN)
+        return malloc(size);
+
+    pool_block_t **const list = &pl->free_lists[size / ALLOC_ALIGN - 1];
+    p = *list;
+    if (p) {
+        *list = p->next;
+        return p;
+    }
+    if (!pl->chunks || ALLOC_CHUNK - pl->used < size) {
+        pool_chunk_t *const chunk = malloc(ALLOC_CHUNK);
+        if (!chunk)
+            return NULL;
+        chunk->next = pl->chunks;
+        pl->chunks = chunk;
+        pl->used = sizeof(pool_chunk_t);
+    }
+    p = (pool_block_t *) ((char *) pl->chunks + pl->used);
+    pl->used += size;
+    return p;
+}
+
+static void pool_release(allocator_t *a, void *p, size_t size)
+{
+    pool_t *const pl = (pool_t *) a;
+    pool_block_t *const block = p;
+
+    size = align_up(size);
+    if (size > POOL_CLASSES * ALLOC_ALIGN) {
+        free(p);
+        return;
+    }
+    block->next = pl->free_lists[size / ALLOC_ALIGN - 1];
+    pl->free_lists[size / ALLOC_ALIGN - 1] = block;
+}
+
+static void pool_destroy(allocator_t *a)
+{
+    pool_t *const pl = (pool_t *) a;
+
+    for (pool_chunk_t *c = pl->chunks; c;) {
+        pool_chunk_t *const next = c->next;
+        free(c);
+        c = next;
+    }
+    free(pl);
+}
+
+allocator_t *alloc_pool_new()
+{
+    pool_t *const pl = malloc(sizeof(pool_t));
+
+    if (!pl)
+        return NULL;
+    pl->ops = (allocator_t){
+        .name = "pool",
+        .alloc = pool_alloc,
+        .release = pool_release,
+        .destroy = pool_destroy,
+    };
+    for (size_t c = 0; c < POOL_CLASSES; ++c)
+        pl->free_lists[c] = NULL;
+    pl->chunks = NULL;
+    pl->used = 0;
+    return &pl->ops;
+}
+
+/* Tracked allocator */
+
+/* Values marking blocks, as in the harness */
+#define MAGICHEADER 0xdeadbeef
+#define MAGICFREE 0xffffffff
+#define MAGICFOOTER 0xbeefdead
+#define FILLCHAR 0x55
+
+/* Header of a tracked block, keeping its payload aligned */
+typedef struct {
+    size_t size;  /* The size of the payload */
+    size_t magic; /* MAGICHEADER while in use */
+} track_header_t;
+
+/*
+ * Set of the blocks in use, by open addressing with linear probing.
+ * Removal shifts the following blocks back, as in hash tables of strings.
+ */
+typedef struct {
+    void **slots;    /* Payloads of blocks, NULL if the slot is empty */
+    size_t capacity; /* The number of slots, which is 0 or a power of 2 */
+    size_t count;    /* The number of blocks */
+} block_set_t;
+
+typedef struct {
+    allocator_t ops;
+    allocator_t *inner;  /* The allocator the blocks come from */
+    alloc_stats_t stats; /* Counts of the blocks */
+    block_set_t live;    /* The blocks handed out and not taken back */
+} tracked_t;
+
+/* Return the home slot of `p` in a set of `capacity` slots */
+static size_t block_home(const void *p, size_t capacity)
+{
+    const uint64_t h = (uint64_t) ((uintptr_t) p / ALLOC_ALIGN) *
+                       0x9e3779b97f4a7c15ULL;
+    return (size_t) (h >> 32) & (capacity - 1);
+}
+
+/* Return the slot holding `p`, or SIZE_MAX if `p` is not in `set` */
+static size_t block_find(const block_set_t *set, const void *p)
+{
+    if (!set->capacity)
+        return SIZE_MAX;
+
+    const size_t mask = set->capacity - 1;
+    for (size_t k = block_home(p, set->capacity); set->slots[k];
+         k = (k + 1) & mask) {
+        if (set->slots[k] == p)
+            return k;
+    }
+    return SIZE_MAX;
+}
+
+/* Put `p` into the first empty slot from its home slot */
+static void block_place(void **slots, size_t capacity, void *p)
+{
+    size_t k = block_home(p, capacity);
+
+    while (slots[k])
+        k = (k + 1) & (capacity - 1);
+    slots[k] = p;
+}
+
+/*
+ * Add `p` to `set`, growing it to keep the load factor at most 1/2.
+ * Return false if could not allocate space.
+ */
+static bool block_add(block_set_t *set, void *p)
+{
+    if ((set->count + 1) * 2 > set->capacity) {
+        const size_t capacity = (set->capacity) ? 2 * set->capacity : 64;
+        void **const slots = calloc(capacity, sizeof(void *));
+        if (!slots)
+            return false;
+        for (size_t k = 0; k < set->capacity; ++k) {
+            if (set->slots[k])
+                block_place(slots, capacity, set->slots[k]);
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->capacity = capacity;
+    }
+    block_place(set->slots, set->capacity, p);
+    ++set->count;
+    return true;
+}
+
+/* Remove the block in slot `hole` of `set` */
+static void block_remove(block_set_t *set, size_t hole)
+{
+    const size_t mask = set->capacity - 1;
+
+    /* Shift back the following blocks which may not stay behind the hole */
+    for (size_t k = (hole + 1) & mask; set->slots[k]; k = (k + 1) & mask) {
+        const size_t home = block_home(set->slots[k], set->capacity);
+        const bool stay = (hole < k) ? (hole < home && home <= k)
+                                     : (hole < home || home <= k);
+        if (!stay) {
+            set->slots[hole] = set->slots[k];
+            hole = k;
+        }
+    }
+    set->slots[hole] = NULL;
+    --set->count;
+}
+
+/* Misuses reported by all tracked allocators */
+static size_t tracked_errors = 0;
+
+/* Count a misuse of `t`, which may be reported from any thread */
+static void track_error(tracked_t *t)
+{
+    ++t->stats.errors;
+    __atomic_fetch_add(&tracked_errors, 1, __ATOMIC_RELAXED);
+}
+
+/* Return the bytes taken from the inner allocator for `size` bytes */
+static size_t track_total(size_t size)
+{
+    return sizeof(track_header_t) + size + sizeof(size_t);
+}
+
+static void *tracked_alloc(allocator_t *a, size_t size)
+{
+    tracked_t *const t = (tracked_t *) a;
+    const size_t footer = MAGICFOOTER;
+    track_header_t *h;
+
+    if (size > SIZE_MAX - track_total(0))
+        return NULL;
+    h = t->inner->alloc(t->inner, track_total(size));
+    if (!h)
+        return NULL;
+    if (!block_add(&t->live, h + 1)) {
+        t->inner->release(t->inner, h, track_total(size));
+        return NULL;
+    }
+    h->size = size;
+    h->magic = MAGICHEADER;
+    memset(h + 1, FILLCHAR, size);
+    memcpy((char *) (h + 1) + size, &footer, sizeof(footer));
+
+    ++t->stats.blocks;
+    t->stats.bytes += size;
+    if (t->stats.bytes > t->stats.peak_bytes)
+        t->stats.peak_bytes = t->stats.bytes;
+    return h + 1;
+}
+
+static void tracked_release(allocator_t *a, void *p, size_t size)
+{
+    tracked_t *const t = (tracked_t *) a;
+    track_header_t *const h = (track_header_t *) p - 1;
+    const size_t slot = block_find(&t->live, p);
+    size_t footer;
+
+    /* The header of a block not in use may be unmapped already */
+    if (slot == SIZE_MAX) {
+        report_event(MSG_ERROR,
+                     "Attempted to release a block %s allocator did not "
+                     "hand out or took back already.  Address = %p",
+                     t->inner->name, p);
+        track_error(t);
+        return;
+    }
+    block_remove(&t->live, slot);
+    if (h->magic != MAGICHEADER) {
+        report_event(MSG_ERROR,
+                     "Attempted to release a block of %s allocator whose "
+                     "header is corrupted",
+                     t->inner->name);
+        track_error(t);
+        return;
+    }
+    if (h->size != size) {
+        report_event(MSG_ERROR,
+                     "Released %lu bytes of a block of %lu bytes of %s "
+                     "allocator",
+                     size, h->size, t->inner->name);
+        track_error(t);
+    }
+    memcpy(&footer, (char *) p + h->size, sizeof(footer));
+    if (footer != MAGICFOOTER) {
+        report_event(MSG_ERROR,
+                     "Corruption detected past the end of a block of %lu "
+                     "bytes of %s allocator",
+                     h->size, t->inner->name);
+        track_error(t);
+    }
+
+    --t->stats.blocks;
+    t->stats.bytes -= h->size;
+    size = h->size;
+    memset(p, FILLCHAR, size);
+    h->magic = MAGICFREE;
+    t->inner->release(t->inner, h, track_total(size));
+}
+
+static void tracked_destroy(allocator_t *a)
+{
+    tracked_t *const t = (tracked_t *) a;
+
+    if (t->stats.blocks) {
+        report_event(MSG_ERROR,
+                     "%lu block(s) of %lu bytes left in use in %s allocator",
+                     t->stats.blocks, t->stats.bytes, t->inner->name);
+        track_error(t);
+    }
+    alloc_destroy(t->inner);
+    free(t->live.slots);
+    free(t);
+}
+
+allocator_t *alloc_tracked_new(allocator_t *inner)
+{
+    tracked_t *t;
+
+    if (!inner)
+        return NULL;
+    t = malloc(sizeof(tracked_t));
+    if (!t) {
+        alloc_destroy(inner);
+        return NULL;
+    }
+    t->ops = (allocator_t){
+        .name = inner->name,
+        .alloc = tracked_alloc,
+        .release = tracked_release,
+        .destroy = tracked_destroy,
+    };
+    t->inner = inner;
+    t->stats = (alloc_stats_t){0};
+    t->live = (block_set_t){NULL, 0, 0};
+    return &t->ops;
+}
+
+bool alloc_tracked_stats(const allocator_t *a, alloc_stats_t *stats)
+{
+    if (!a || a->alloc != tracked_alloc)
+        return false;
+    *stats = ((const tracked_t *) a)->stats;
+    return true;
+}
+
+size_t alloc_tracked_errors()
+{
+    return __atomic_load_n(&tracked_errors, __ATOMIC_RELAXED);
+}
+
+void alloc_destroy(allocator_t *a)
+{
+    if (a)
+        a->destroy(a);
+}
@@ -0,0 +1,82 @@
+#ifndef LAB0_ALLOCATOR_H
+#define LAB0_ALLOCATOR_H
+
+/*
+ * This program implements allocators the queue can take its elements from.
+ *
+ * Each allocator is a table of operations, so that a queue created with
+ * `q_new_with_allocator()` works the same on any of them:
+ *  - system: malloc and free of the C library;
+ *  - bump: blocks carved in turn from 64 KiB chunks, each of which is
+ *    returned as soon as none of its blocks is in use;
+ *  - pool: free lists of blocks by classes of 16 bytes, refilled from
+ *    shared chunks kept until the pool is destroyed.
+ * A tracked allocator wraps any other one and checks each block the way the
+ * harness does: it marks both ends, fills blocks when handed out and taken
+ * back, reports blocks taken back twice, corrupted or with the wrong size,
+ * and reports the blocks still in use when destroyed.  It keeps a set of
+ * the blocks in use, so that a block it did not hand out is reported before
+ * being touched, even if its memory went back to the system.
+ *
+ * Allocators get their memory from the C library directly, so the blocks
+ * of the harness do not include them; track them to check their use.
+ * An allocator is not thread-safe, and blocks of up to 256 bytes are
+ * aligned to 16 bytes.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct ALLOCATOR allocator_t;
+
+/* Operations of an allocator */
+struct ALLOCATOR {
+    const char *name;
+    /* Return a block of `size` bytes, or NULL if could not allocate space */
+    void *(*alloc)(allocator_t *a, size_t size);
+    /* Take back the block `p` of `size` bytes returned by `alloc` */
+    void (*release)(allocator_t *a, void *p, size_t size);
+    /* Free the allocator with all its memory */
+    void (*destroy)(allocator_t *a);
+};
+
+/* Counts of a tracked allocator */
+typedef struct {
+    size_t blocks;     /* Blocks in use */
+    size_t bytes;      /* Bytes in use */
+    size_t peak_bytes; /* The maximum of `bytes` so far */
+    size_t errors;     /* Misuses reported */
+} alloc_stats_t;
+
+/* Return the allocator of the C library, which needs no destroying */
+allocator_t *alloc_system();
+
+/* Create a bump allocator. Return NULL if could not allocate space */
+allocator_t *alloc_bump_new();
+
+/* Create a pool allocator. Return NULL if could not allocate space */
+allocator_t *alloc_pool_new();
+
+/*
+ * Create an allocator checking the blocks taken from `inner`, which it
+ * destroys along with itself.
+ * Return NULL, destroying `inner`, if could not allocate space.
+ */
+allocator_t *alloc_tracked_new(allocator_t *inner);
+
+/*
+ * Fill *stats with the counts of `a`.
+ * Return false, with no effect, if `a` is not tracked.
+ */
+bool alloc_tracked_stats(const allocator_t *a, alloc_stats_t *stats);
+
+/*
+ * Return the number of misuses and blocks left in use reported by all
+ * tracked allocators so far, including destroyed ones
+ */
+size_t alloc_tracked_errors();
+
+/* Free `a` with all its memory. No effect if a is NULL */
+void alloc_destroy(allocator_t *a);
+
+#endif /* LAB0_ALLOCATOR_H */
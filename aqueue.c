@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "aqueue.h"
+#include "harness.h"
+
+/* The number of slots of a new arena */
+#define AQ_MIN_CAPACITY 16
+
+/* Return the slot at index `i` of `aq` */
+#define AQ_SLOT(aq, i) (&(aq)->slots[i])
+
+/* Whether the string of `e` is allocated apart */
+static inline bool ele_is_long(const aq_ele_t *e)
+{
+    return e->value[AQ_INLINE_MAX] != '\0';
+}
+
+/* Return the string allocated apart for `e` */
+static inline char *ele_long(const aq_ele_t *e)
+{
+    char *p;
+    memcpy(&p, e->value, sizeof(p));
+    return p;
+}
+
+/*
+ * Create empty arena queue.
+ * Return NULL if could not allocate space.
+ */
+aqueue_t *aq_new()
+{
+    aqueue_t *const aq = malloc(sizeof(aqueue_t));
+    if (!aq)
+        return NULL;
+    aq->slots = malloc(AQ_MIN_CAPACITY * sizeof(aq_ele_t));
+    if (!aq->slots) {
+        free(aq);
+        return NULL;
+    }
+    aq->cap = AQ_MIN_CAPACITY;
+    aq->used = 0;
+    aq->free_list = aq->head = aq->tail = AQ_NONE;
+    aq->size = aq->long_bytes = 0;
+    return aq;
+}
+
+/* Free all storage used by arena queue */
+void aq_free(aqueue_t *aq)
+{
+    if (!aq)
+        return;
+    for (uint32_t i = aq->head; i != AQ_NONE; i = AQ_SLOT(aq, i)->next) {
+        if (ele_is_long(AQ_SLOT(aq, i)))
+            free(ele_long(AQ_SLOT(aq, i)));
+    }
+    free(aq->slots);
+    free(aq);
+}
+
+/*
+ * Take a slot of `aq` and copy `s` into it, or into a separate allocation if
+ * too long, doubling the arena if full.
+ * Return the index of the slot, or AQ_NONE if could not allocate space.
+ * Note: the `next` of the slot will not be initialized.
+ */
+static uint32_t ele_new(aqueue_t *aq, const char *s)
+{
+    const size_t len = strlen(s);
+    char *p = NULL;
+    uint32_t i;
+    aq_ele_t *e;
+
+    if (len > AQ_INLINE_MAX) {
+        p = malloc(len + 1);
+        if (!p)
+            return AQ_NONE;
+        memcpy(p, s, len + 1);
+    }
+
+    if (aq->free_list != AQ_NONE) {
+        i = aq->free_list;
+        aq->free_list = AQ_SLOT(aq, i)->next;
+    } else {
+        if (aq->used == aq->cap) {
+            /* Keep AQ_NONE out of the indexes */
+            const uint32_t cap =
+                (aq->cap < AQ_NONE / 2) ? 2 * aq->cap : AQ_NONE;
+            aq_ele_t *slots;
+            if (cap == aq->cap ||
+                !(slots = malloc((size_t) cap * sizeof(aq_ele_t)))) {
+                free(p);
+                return AQ_NONE;
+            }
+            memcpy(slots, aq->slots, (size_t) aq->used * sizeof(aq_ele_t));
+            free(aq->slots);
+            aq->slots = slots;
+            aq->cap = cap;
+        }
+        i = aq->used++;
+    }
+
+    e = AQ_SLOT(aq, i);
+    memset(e->value, 0, sizeof(e->value));
+    if (p) {
+        memcpy(e->value, &p, sizeof(p));
+        e->value[AQ_INLINE_MAX] = 1;
+        aq->long_bytes += len + 1;
+    } else {
+        memcpy(e->value, s, len);
+    }
+    return i;
+}
+
+/*
+ * Attempt to insert element at head of arena queue.
+ * Return true if successful.
+ * Return false if aq is NULL or could not allocate space.
+ */
+bool aq_insert_head(aqueue_t *aq, const char *s)
+{
+    uint32_t i;
+
+    if (!aq || (i = ele_new(aq, s)) == AQ_NONE)
+        return false;
+    AQ_SLOT(aq, i)->next = aq->head;
+    aq->head = i;
+    if (aq->tail == AQ_NONE)
+        aq->tail = i;
+    ++aq->size;
+    return true;
+}
+
+/*
+ * Attempt to insert element at tail of arena queue.
+ * Return true if successful.
+ * Return false if aq is NULL or could not allocate space.
+ */
+bool aq_insert_tail(aqueue_t *aq, const char *s)
+{
+    uint32_t i;
+
+    if (!aq || (i = ele_new(aq, s)) == AQ_NONE)
+        return false;
+    AQ_SLOT(aq, i)->next = AQ_NONE;
+    if (aq->tail != AQ_NONE)
+        AQ_SLOT(aq, aq->tail)->next = i;
+    else
+        aq->head = i;
+    aq->tail = i;
+    ++aq->size;
+    return true;
+}
+
+/*
+ * Attempt to remove element from head of arena queue.
+ * Return true if successful.
+ * Return false if aq is NULL or empty.
+ * If sp is non-NULL and an element is removed, copy the removed string to
+ * *sp (up to a maximum of bufsize-1 characters, plus a null terminator.)
+ */
+bool aq_remove_head(aqueue_t *aq, char *sp, size_t bufsize)
+{
+    uint32_t i;
+    aq_ele_t *e;
+
+    if (!aq || (i = aq->head) == AQ_NONE)
+        return false;
+
+    e = AQ_SLOT(aq, i);
+    if (sp && bufsize) {
+        const char *const value = aq_value(aq, i);
+        const size_t len = strnlen(value, bufsize - 1);
+        memcpy(sp, value, len);
+        sp[len] = '\0';
+    }
+    if (ele_is_long(e)) {
+        char *const p = ele_long(e);
+        aq->long_bytes -= strlen(p) + 1;
+        free(p);
+    }
+
+    aq->head = e->next;
+    if (aq->head == AQ_NONE)
+        aq->tail = AQ_NONE;
+    e->next = aq->free_list;
+    aq->free_list = i;
+    --aq->size;
+    return true;
+}
+
+/*
+ * Return number of elements in arena queue.
+ * Return 0 if `aq` is NULL or empty
+ */
+size_t aq_size(const aqueue_t *aq)
+{
+    return (aq) ? aq->size : 0;
+}
+
+/* Return the string of the element at index `i` of `aq` */
+const char *aq_value(const aqueue_t *aq, uint32_t i)
+{
+    const aq_ele_t *const e = AQ_SLOT(aq, i);
+    return ele_is_long(e) ? ele_long(e) : e->value;
+}
+
+/* Return the bytes taken by `aq` */
+size_t aq_bytes(const aqueue_t *aq)
+{
+    if (!aq)
+        return 0;
+    return sizeof(aqueue_t) + (size_t) aq->cap * sizeof(aq_ele_t) +
+           aq->long_bytes;
+}
+
+/*
+ * Reverse elements in arena queue
+ * No effect if aq is NULL or empty
+ */
+void aq_reverse(aqueue_t *aq)
+{
+    uint32_t prev = AQ_NONE;
+
+    if (!aq || aq->head == AQ_NONE)
+        return;
+    for (uint32_t k = aq->head; k != AQ_NONE;) {
+        aq_ele_t *const e = AQ_SLOT(aq, k);
+        const uint32_t next = e->next;
+        e->next = prev;
+        prev = k;
+        k = next;
+    }
+    aq->tail = aq->head;
+    aq->head = prev;
+}
+
+/*
+ * Merge sort `len` elements of `aq` starting with `head` by `cmp`, and set
+ * *tailp to the tail of the sorted list
+ */
+static uint32_t ele_sort(aqueue_t *aq,
+                         uint32_t head,
+                         size_t len,
+                         cmp_func_t cmp,
+                         uint32_t *tailp)
+{
+    uint32_t left, right, merge, ltail, rtail;
+
+    if (len == 1) {
+        AQ_SLOT(aq, head)->next = AQ_NONE;
+        *tailp = head;
+        return head;
+    }
+
+    right = head;
+    for (size_t k = 1; k < len / 2; ++k)
+        right = AQ_SLOT(aq, right)->next;
+    {
+        const uint32_t next = AQ_SLOT(aq, right)->next;
+        AQ_SLOT(aq, right)->next = AQ_NONE;
+        right = next;
+    }
+    left = ele_sort(aq, head, len / 2, cmp, &ltail);
+    right = ele_sort(aq, right, len - len / 2, cmp, &rtail);
+
+    /* Take the first of equal elements from the left to keep the order */
+    {
+        uint32_t *const phead =
+            (cmp(aq_value(aq, left), aq_value(aq, right)) <= 0) ? &left
+                                                                : &right;
+        merge = head = *phead;
+        *phead = AQ_SLOT(aq, *phead)->next;
+    }
+    while (left != AQ_NONE && right != AQ_NONE) {
+        uint32_t *const pnext =
+            (cmp(aq_value(aq, left), aq_value(aq, right)) <= 0) ? &left
+                                                                : &right;
+        AQ_SLOT(aq, merge)->next = *pnext;
+        merge = *pnext;
+        *pnext = AQ_SLOT(aq, *pnext)->next;
+    }
+    if (left != AQ_NONE) {
+        AQ_SLOT(aq, merge)->next = left;
+        *tailp = ltail;
+    } else {
+        AQ_SLOT(aq, merge)->next = right;
+        *tailp = rtail;
+    }
+    return head;
+}
+
+/*
+ * Sort elements of arena queue in ascending order by `cmp`
+ * No effect if aq is NULL or empty
+ */
+void aq_sort(aqueue_t *aq, cmp_func_t cmp)
+{
+    if (!aq || aq->size < 2)
+        return;
+    aq->head = ele_sort(aq, aq->head, aq->size, cmp, &aq->tail);
+}
@@ -0,0 +1,120 @@
+#ifndef LAB0_AQUEUE_H
+#define LAB0_AQUEUE_H
+
+/*
+ * This program implements a queue of strings whose elements live in an
+ * arena.
+ *
+ * The elements are slots of one array owned by the queue, linked by 32-bit
+ * indexes instead of pointers.  A string of at most AQ_INLINE_MAX characters
+ * is kept in its slot, so that such an element takes 16 bytes in all; a
+ * longer one is allocated apart and the slot points to it.
+ * The array doubles when full.  Indexes stay valid as it moves, and the
+ * slots of removed elements are taken again before it grows.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compare.h"
+
+/* Index of no element */
+#define AQ_NONE UINT32_MAX
+
+/* The length of the longest string kept in a slot */
+#define AQ_INLINE_MAX 11
+
+/* Data structure declarations */
+
+/* Element slot */
+typedef struct {
+    uint32_t next; /* The index of the next element, or AQ_NONE */
+    /* The string, padded with zeros, if at most AQ_INLINE_MAX characters
+     * long; otherwise a pointer to it in the first bytes, and a nonzero last
+     * byte */
+    char value[AQ_INLINE_MAX + 1];
+} aq_ele_t;
+
+/* Arena queue structure */
+typedef struct {
+    aq_ele_t *slots;    /* The arena */
+    uint32_t cap;       /* The number of slots */
+    uint32_t used;      /* The slots ever taken, from the first one */
+    uint32_t free_list; /* Released slots, linked by `next` */
+    uint32_t head;      /* The first element, or AQ_NONE */
+    uint32_t tail;      /* The last element, or AQ_NONE */
+    size_t size;        /* The number of elements */
+    size_t long_bytes;  /* The bytes of strings allocated apart */
+} aqueue_t;
+
+/* Operations on arena queue */
+
+/*
+ * Create empty arena queue.
+ * Return NULL if could not allocate space.
+ */
+aqueue_t *aq_new();
+
+/*
+ * Free ALL storage used by arena queue.
+ * No effect if aq is NULL
+ */
+void aq_free(aqueue_t *aq);
+
+/*
+ * Attempt to insert a copy of string s at head of arena queue.
+ * Return true if successful.
+ * Return false if aq is NULL, holds AQ_NONE elements already, or could not
+ * allocate space.
+ */
+bool aq_insert_head(aqueue_t *aq, const char *s);
+
+/*
+ * Attempt to insert a copy of string s at tail of arena queue.
+ * Return true if successful.
+ * Return false if aq is NULL, holds AQ_NONE elements already, or could not
+ * allocate space.
+ */
+bool aq_insert_tail(aqueue_t *aq, const char *s);
+
+/*
+ * Attempt to remove element from head of arena queue.
+ * Return true if successful.
+ * Return false if aq is NULL or empty.
+ * If sp is non-NULL and an element is removed, copy the removed string to
+ * *sp (up to a maximum of bufsize-1 characters, plus a null terminator.)
+ */
+bool aq_remove_head(aqueue_t *aq, char *sp, size_t bufsize);
+
+/*
+ * Return number of elements in arena queue.
+ * Return 0 if aq is NULL or empty
+ */
+size_t aq_size(const aqueue_t *aq);
+
+/* Return the string of the element at index i of arena queue */
+const char *aq_value(const aqueue_t *aq, uint32_t i);
+
+/*
+ * Return the bytes taken by arena queue: its structure, its arena and the
+ * strings allocated apart.
+ * Return 0 if aq is NULL
+ */
+size_t aq_bytes(const aqueue_t *aq);
+
+/*
+ * Reverse elements in arena queue.
+ * No effect if aq is NULL or empty
+ * This function does not allocate or free any storage.
+ */
+void aq_reverse(aqueue_t *aq);
+
+/*
+ * Sort elements of arena queue in ascending order by cmp.
+ * No effect if aq is NULL or empty
+ * This function does not allocate or free any storage.
+ */
+void aq_sort(aqueue_t *aq, cmp_func_t cmp);
+
+#endif /* LAB0_AQUEUE_H */
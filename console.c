@@ -1,6 +1,7 @@
 /* Implementation of simple command-line interface */
 
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -342,6 +343,18 @@ bool get_int(char *vname, int *loc)
     return true;
 }
 
+bool get_long(char *vname, long *loc)
+{
+    char *end = NULL;
+    errno = 0;
+    long v = strtol(vname, &end, 0);
+    if (errno || end == vname || *end != '\0')
+        return false;
+
+    *loc = v;
+    return true;
+}
+
 static bool do_option_cmd(int argc, char *argv[])
 {
     if (argc == 1) {
@@ -51,6 +51,12 @@ void add_param(char *name,
 /* Extract integer from text and store at loc */
 bool get_int(char *vname, int *loc);
 
+/*
+ * Extract 64-bit integer from text and store at loc.
+ * Return false if it does not fit.
+ */
+bool get_long(char *vname, long *loc);
+
 /* Add function to be executed as part of program exit */
 void add_quit_helper(cmd_function qf);
 
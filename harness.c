@@ -1,5 +1,8 @@
 /* Test support code */
 
+/* For PTHREAD_ERRORCHECK_MUTEX_INITIALIZER_NP */
+#define _GNU_SOURCE
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -36,23 +39,54 @@
 typedef struct BELE {
     struct BELE *next, *prev;
     size_t payload_size;
-    size_t magic_header; /* Marker to see if block seems legitimate */
+    unsigned owner;        /* The owner the block is counted for */
+    unsigned magic_header; /* Marker to see if block seems legitimate */
     unsigned char payload[0];
     /* Also place magic number at tail of every block */
 } block_ele_t;
 
 static block_ele_t *allocated = NULL;
 static size_t allocated_count = 0;
+static size_t owned_count[ALLOC_OWNERS];
+/* Payload bytes currently allocated, and their peak since last reset */
+static size_t allocated_bytes = 0;
+static size_t peak_bytes = 0;
 
 /* Percent probability of malloc failure */
 int fail_probability = 0;
 
-static bool cautious_mode = true;
-static bool noallocate_mode = false;
-static bool error_occurred = false;
-static char *error_message = "";
+/*
+ * The modes apply to the thread setting them, so that a thread freeing
+ * structures in the background is not held to the restrictions of the
+ * operation under test.  Errors are flagged for the thread running into
+ * them, which checks them itself.
+ */
+static __thread bool cautious_mode = true;
+static __thread bool noallocate_mode = false;
+static __thread bool quiet_mode = false;
+static __thread unsigned alloc_owner = 0;
+static __thread bool error_occurred = false;
+static __thread char *error_message = "";
+
+/*
+ * Report an event, unless the calling thread is quiet: reporting is not
+ * thread-safe, and a fatal event exits the whole program
+ */
+#define harness_event(...)             \
+    do {                               \
+        if (!quiet_mode)               \
+            report_event(__VA_ARGS__); \
+    } while (0)
 
-static int time_limit = 1;
+/* Seconds allowed for each risky operation, 0 if unlimited */
+int time_limit = 1;
+
+/*
+ * Guards the list of blocks and the counts.
+ * It checks its owner, so that the recovery from an exception can release it
+ * only if the operation was interrupted while holding it.
+ */
+static pthread_mutex_t block_lock = PTHREAD_ERRORCHECK_MUTEX_INITIALIZER_NP;
 
 /*
  * Data for managing exceptions
@@ -79,7 +113,7 @@ static bool fail_allocation()
 static block_ele_t *find_header(void *p)
 {
     if (!p) {
-        report_event(MSG_ERROR, "Attempting to free null block");
+        harness_event(MSG_ERROR, "Attempting to free null block");
         error_occurred = true;
     }
 
@@ -93,15 +127,15 @@ static block_ele_t *find_header(void *p)
             ab = ab->next;
         }
         if (!found) {
-            report_event(MSG_ERROR,
-                         "Attempted to free unallocated block.  Address = %p",
-                         p);
+            harness_event(MSG_ERROR,
+                          "Attempted to free unallocated block.  Address = %p",
+                          p);
             error_occurred = true;
         }
     }
 
     if (b->magic_header != MAGICHEADER) {
-        report_event(
+        harness_event(
             MSG_ERROR,
             "Attempted to free unallocated or corrupted block.  Address = %p",
             p);
@@ -125,29 +159,33 @@ static size_t *find_footer(block_ele_t *b)
 void *test_malloc(size_t size)
 {
     if (noallocate_mode) {
-        report_event(MSG_FATAL, "Calls to malloc disallowed");
+        harness_event(MSG_FATAL, "Calls to malloc disallowed");
+        error_occurred = true;
         return NULL;
     }
 
     if (fail_allocation()) {
-        report_event(MSG_WARN, "Malloc returning NULL");
+        harness_event(MSG_WARN, "Malloc returning NULL");
         return NULL;
     }
 
     block_ele_t *new_block =
         malloc(size + sizeof(block_ele_t) + sizeof(size_t));
     if (!new_block) {
-        report_event(MSG_FATAL, "Couldn't allocate any more memory");
+        harness_event(MSG_FATAL, "Couldn't allocate any more memory");
         error_occurred = true;
+        return NULL;
     }
 
     // cppcheck-suppress nullPointerRedundantCheck
     new_block->magic_header = MAGICHEADER;
     // cppcheck-suppress nullPointerRedundantCheck
     new_block->payload_size = size;
+    new_block->owner = alloc_owner;
     *find_footer(new_block) = MAGICFOOTER;
     void *p = (void *) &new_block->payload;
     memset(p, FILLCHAR, size);
+    pthread_mutex_lock(&block_lock);
     // cppcheck-suppress nullPointerRedundantCheck
     new_block->next = allocated;
     // cppcheck-suppress nullPointerRedundantCheck
@@ -157,6 +195,11 @@ void *test_malloc(size_t size)
         allocated->prev = new_block;
     allocated = new_block;
     allocated_count++;
+    owned_count[new_block->owner]++;
+    allocated_bytes += size;
+    if (allocated_bytes > peak_bytes)
+        peak_bytes = allocated_bytes;
+    pthread_mutex_unlock(&block_lock);
 
     return p;
 }
@@ -176,25 +219,26 @@ void *test_calloc(size_t nelem, size_t elsize)
 void test_free(void *p)
 {
     if (noallocate_mode) {
-        report_event(MSG_FATAL, "Calls to free disallowed");
+        harness_event(MSG_FATAL, "Calls to free disallowed");
+        error_occurred = true;
         return;
     }
 
     if (!p)
         return;
 
+    pthread_mutex_lock(&block_lock);
     block_ele_t *b = find_header(p);
     size_t footer = *find_footer(b);
     if (footer != MAGICFOOTER) {
-        report_event(MSG_ERROR,
-                     "Corruption detected in block with address %p when "
-                     "attempting to free it",
-                     p);
+        harness_event(MSG_ERROR,
+                      "Corruption detected in block with address %p when "
+                      "attempting to free it",
+                      p);
         error_occurred = true;
     }
     b->magic_header = MAGICFREE;
     *find_footer(b) = MAGICFREE;
-    memset(p, FILLCHAR, b->payload_size);
 
     /* Unlink from list */
     block_ele_t *bn = b->next;
@@ -206,8 +250,13 @@ void test_free(void *p)
     if (bn)
         bn->prev = bp;
 
-    free(b);
+    allocated_bytes -= b->payload_size;
     allocated_count--;
+    owned_count[b->owner]--;
+    pthread_mutex_unlock(&block_lock);
+
+    memset(p, FILLCHAR, b->payload_size);
+    free(b);
 }
 
 // cppcheck-suppress unusedFunction
@@ -223,7 +272,36 @@ char *test_strdup(const char *s)
 
 size_t allocation_check()
 {
-    return allocated_count;
+    pthread_mutex_lock(&block_lock);
+    size_t cnt = allocated_count;
+    pthread_mutex_unlock(&block_lock);
+    return cnt;
+}
+
+size_t allocation_owned(int owner)
+{
+    pthread_mutex_lock(&block_lock);
+    size_t cnt = owned_count[owner];
+    pthread_mutex_unlock(&block_lock);
+    return cnt;
+}
+
+size_t allocation_bytes()
+{
+    pthread_mutex_lock(&block_lock);
+    size_t bytes = allocated_bytes;
+    pthread_mutex_unlock(&block_lock);
+    return bytes;
+}
+
+size_t allocation_peak_bytes(bool reset)
+{
+    pthread_mutex_lock(&block_lock);
+    size_t peak = peak_bytes;
+    if (reset)
+        peak_bytes = allocated_bytes;
+    pthread_mutex_unlock(&block_lock);
+    return peak;
 }
 
 /*
@@ -231,7 +309,7 @@ size_t allocation_check()
  */
 
 /*
- * Set/unset cautious mode.
+ * Set/unset cautious mode of the calling thread.
  * In this mode, makes extra sure any block to be freed is currently allocated.
  */
 void set_cautious_mode(bool cautious)
@@ -240,7 +318,7 @@ void set_cautious_mode(bool cautious)
 }
 
 /*
- * Set/unset restricted allocation mode.
+ * Set/unset restricted allocation mode of the calling thread.
  * In this mode, calls to malloc and free are disallowed.
  */
 void set_noallocate_mode(bool noallocate)
@@ -248,6 +326,23 @@ void set_noallocate_mode(bool noallocate)
     noallocate_mode = noallocate;
 }
 
+/*
+ * Set the owner of the blocks the calling thread allocates from now on.
+ */
+void set_allocation_owner(int owner)
+{
+    alloc_owner = owner;
+}
+
+/*
+ * Set/unset quiet mode of the calling thread.
+ * In this mode, errors, even fatal ones, are only flagged for error_check().
+ */
+void set_quiet_mode(bool quiet)
+{
+    quiet_mode = quiet;
+}
+
 /*
  * Return whether any errors have occurred since last time set error limit
  */
@@ -267,6 +362,8 @@ bool exception_setup(bool limit_time)
     if (sigsetjmp(env, 1)) {
         /* Got here from longjmp */
         jmp_ready = false;
+        /* Fails harmlessly unless the operation held the lock */
+        pthread_mutex_unlock(&block_lock);
         if (time_limited) {
             alarm(0);
             time_limited = false;
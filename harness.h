@@ -22,23 +22,55 @@ char *test_strdup(const char *s);
 /* Report number of allocated blocks */
 size_t allocation_check();
 
+/* Number of owners which allocated blocks are counted for */
+#define ALLOC_OWNERS 32
+
+/* Report number of allocated blocks of owner, in [0, ALLOC_OWNERS) */
+size_t allocation_owned(int owner);
+
+/* Report number of bytes in allocated blocks */
+size_t allocation_bytes();
+
+/*
+ * Report peak number of bytes in allocated blocks since last reset.
+ * Optionally start over from the current number.
+ */
+size_t allocation_peak_bytes(bool reset);
+
 /* Probability of malloc failing, expressed as percent */
 extern int fail_probability;
 
+/* Seconds allowed for each risky operation, 0 if unlimited */
+extern int time_limit;
+
 /*
- * Set/unset cautious mode.
+ * Set/unset cautious mode of the calling thread.
  * In this mode, makes extra sure any block to be freed is currently allocated.
  */
 void set_cautious_mode(bool cautious);
 
 /*
- * Set/unset restricted allocation mode.
+ * Set/unset restricted allocation mode of the calling thread.
  * In this mode, calls to malloc and free are disallowed.
  */
 void set_noallocate_mode(bool noallocate);
 
 /*
-  Return whether any errors have occurred since last time checked
+ * Set the owner, in [0, ALLOC_OWNERS), of the blocks the calling thread
+ * allocates from now on.  Blocks stay counted for the owner they were
+ * allocated for, whichever thread frees them.  The owner is 0 by default.
+ */
+void set_allocation_owner(int owner);
+
+/*
+ * Set/unset quiet mode of the calling thread.
+ * In this mode, errors, even fatal ones, are only flagged for error_check().
+ */
+void set_quiet_mode(bool quiet);
+
+/*
+  Return whether any errors have occurred on the calling thread since last
+  time checked
  */
 bool error_check();
 
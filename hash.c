@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+#include "hash.h"
+
+/* The smallest number of slots */
+#define HASH_MIN_CAPACITY 16
+
+/* Return the hash value of string `s` using FNV-1a */
+uint32_t hash_str(const char *s)
+{
+    uint32_t hv = 2166136261U;
+    for (const unsigned char *p = (const unsigned char *) s; *p; ++p) {
+        hv ^= *p;
+        hv *= 16777619U;
+    }
+    return hv;
+}
+
+/* Return an array of `capacity` empty slots, or NULL */
+static hash_slot_t *hash_slots_alloc(size_t capacity)
+{
+    hash_slot_t *const slots = malloc(capacity * sizeof(hash_slot_t));
+    if (slots) {
+        for (size_t k = 0; k < capacity; ++k)
+            slots[k].item = NULL;
+    }
+    return slots;
+}
+
+/*
+ * Initialize empty table for about `hint` items.
+ * Return false if could not allocate space.
+ */
+bool hash_init(hash_table_t *h, size_t hint, hash_key_func_t key)
+{
+    size_t capacity = HASH_MIN_CAPACITY;
+
+    /* Keep the load factor at most 1/2 */
+    while (capacity / 2 < hint && capacity < SIZE_MAX / 4)
+        capacity *= 2;
+
+    h->slots = hash_slots_alloc(capacity);
+    if (!h->slots)
+        return false;
+    h->capacity = capacity;
+    h->count = 0;
+    h->key = key;
+    return true;
+}
+
+/* Free the slots of table, leaving the items alone */
+void hash_destroy(hash_table_t *h)
+{
+    free(h->slots);
+    h->slots = NULL;
+    h->capacity = h->count = 0;
+}
+
+/*
+ * Return an item whose key equals to `key`, whose hash value is `hv`.
+ * Return NULL if there is none.
+ */
+void *hash_find(const hash_table_t *h, const char *key, uint32_t hv)
+{
+    const size_t mask = h->capacity - 1;
+
+    for (size_t k = hv & mask; h->slots[k].item; k = (k + 1) & mask) {
+        const hash_slot_t *const slot = &h->slots[k];
+        if (slot->hash == hv && !strcmp(h->key(slot->item), key))
+            return slot->item;
+    }
+    return NULL;
+}
+
+/* Put `item` into the first empty slot from its home slot */
+static void hash_place(hash_slot_t *slots,
+                       size_t capacity,
+                       void *item,
+                       uint32_t hv)
+{
+    const size_t mask = capacity - 1;
+    size_t k = hv & mask;
+
+    while (slots[k].item)
+        k = (k + 1) & mask;
+    slots[k].hash = hv;
+    slots[k].item = item;
+}
+
+/*
+ * Add `item`, whose key has hash value `hv`, growing the table if needed.
+ * Return false if could not allocate space.
+ */
+bool hash_insert(hash_table_t *h, void *item, uint32_t hv)
+{
+    if ((h->count + 1) * 2 > h->capacity) {
+        const size_t capacity = h->capacity * 2;
+        hash_slot_t *const slots = hash_slots_alloc(capacity);
+        if (!slots)
+            return false;
+
+        for (size_t k = 0; k < h->capacity; ++k) {
+            if (h->slots[k].item)
+                hash_place(slots, capacity, h->slots[k].item,
+                           h->slots[k].hash);
+        }
+        free(h->slots);
+        h->slots = slots;
+        h->capacity = capacity;
+    }
+
+    hash_place(h->slots, h->capacity, item, hv);
+    ++h->count;
+    return true;
+}
+
+/*
+ * Remove `item`, whose key has hash value `hv`.
+ * Return false if `item` is not in table.
+ */
+bool hash_remove(hash_table_t *h, const void *item, uint32_t hv)
+{
+    const size_t mask = h->capacity - 1;
+    size_t hole = hv & mask;
+
+    while (h->slots[hole].item != item) {
+        if (!h->slots[hole].item)
+            return false;
+        hole = (hole + 1) & mask;
+    }
+
+    /* Shift back the following items which may not stay behind the hole */
+    for (size_t k = (hole + 1) & mask; h->slots[k].item; k = (k + 1) & mask) {
+        const size_t home = h->slots[k].hash & mask;
+        /* Whether `home` is cyclically within (`hole`, `k`] */
+        const bool stay = (hole < k) ? (hole < home && home <= k)
+                                     : (hole < home || home <= k);
+        if (!stay) {
+            h->slots[hole] = h->slots[k];
+            hole = k;
+        }
+    }
+    h->slots[hole].item = NULL;
+
+    --h->count;
+    return true;
+}
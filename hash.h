@@ -0,0 +1,63 @@
+#ifndef LAB0_HASH_H
+#define LAB0_HASH_H
+
+/*
+ * This program implements a hash table of items keyed by strings.
+ *
+ * It uses open addressing with linear probing. Removal shifts the following
+ * items back, so that no tombstone is left behind.
+ * The items are not owned by the table.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Return the key of item */
+typedef const char *(*hash_key_func_t)(const void *item);
+
+/* Slot of the table */
+typedef struct {
+    uint32_t hash; /* The hash value of the key of item */
+    void *item;    /* NULL if the slot is empty */
+} hash_slot_t;
+
+/* Hash table structure */
+typedef struct {
+    hash_slot_t *slots;  /* Array of slots */
+    size_t capacity;     /* The number of slots, which is a power of 2 */
+    size_t count;        /* The number of items */
+    hash_key_func_t key; /* Key of items */
+} hash_table_t;
+
+/* Return the hash value of string s */
+uint32_t hash_str(const char *s);
+
+/*
+ * Initialize empty table for about hint items.
+ * Return false if could not allocate space.
+ */
+bool hash_init(hash_table_t *h, size_t hint, hash_key_func_t key);
+
+/* Free the slots of table, leaving the items alone */
+void hash_destroy(hash_table_t *h);
+
+/*
+ * Return an item whose key equals to key, whose hash value is hv.
+ * Return NULL if there is none.
+ */
+void *hash_find(const hash_table_t *h, const char *key, uint32_t hv);
+
+/*
+ * Add item, whose key has hash value hv, growing the table if needed.
+ * Return false if could not allocate space.
+ */
+bool hash_insert(hash_table_t *h, void *item, uint32_t hv);
+
+/*
+ * Remove item, whose key has hash value hv.
+ * Return false if item is not in table.
+ */
+bool hash_remove(hash_table_t *h, const void *item, uint32_t hv);
+
+#endif /* LAB0_HASH_H */
@@ -0,0 +1,266 @@
+#include <string.h>
+
+#include "keysort.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define KEYSORT_HAVE_AVX2 1
+#else
+#define KEYSORT_HAVE_AVX2 0
+#endif
+
+/* The length of blocks sorted by insertion before merging */
+#define KEYSORT_BLOCK 16
+
+/* Keys with their values */
+typedef struct {
+    int64_t *keys;
+    void **vals;
+} kv_t;
+
+/* The kernel in use, chosen on first use */
+static keysort_kernel_t kernel;
+static bool kernel_chosen = false;
+
+/* Whether the CPU running the program supports AVX2 */
+static bool cpu_has_avx2()
+{
+#if KEYSORT_HAVE_AVX2
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+keysort_kernel_t keysort_set_kernel(keysort_kernel_t k)
+{
+    if (k == KEYSORT_AVX2 && !cpu_has_avx2())
+        k = KEYSORT_SCALAR;
+    kernel = k;
+    kernel_chosen = true;
+    return kernel;
+}
+
+keysort_kernel_t keysort_kernel()
+{
+    if (!kernel_chosen)
+        keysort_set_kernel(KEYSORT_AVX2);
+    return kernel;
+}
+
+/* Return `s` advanced by `i` entries */
+static inline kv_t kv_at(kv_t s, size_t i)
+{
+    return (kv_t){s.keys + i, s.vals + i};
+}
+
+/* Sort `n` entries of `s` by insertion */
+static void block_sort(kv_t s, size_t n)
+{
+    for (size_t i = 1; i < n; ++i) {
+        const int64_t key = s.keys[i];
+        void *const val = s.vals[i];
+        size_t j = i;
+        for (; j > 0 && s.keys[j - 1] > key; --j) {
+            s.keys[j] = s.keys[j - 1];
+            s.vals[j] = s.vals[j - 1];
+        }
+        s.keys[j] = key;
+        s.vals[j] = val;
+    }
+}
+
+/* Merge the sorted `na` entries of `a` and `nb` entries of `b` into `out` */
+static void merge_scalar(kv_t a, size_t na, kv_t b, size_t nb, kv_t out)
+{
+    size_t i = 0, j = 0, k = 0;
+
+    while (i < na && j < nb) {
+        if (b.keys[j] < a.keys[i]) {
+            out.keys[k] = b.keys[j];
+            out.vals[k++] = b.vals[j++];
+        } else {
+            out.keys[k] = a.keys[i];
+            out.vals[k++] = a.vals[i++];
+        }
+    }
+    memcpy(out.keys + k, a.keys + i, (na - i) * sizeof(int64_t));
+    memcpy(out.vals + k, a.vals + i, (na - i) * sizeof(void *));
+    k += na - i;
+    memcpy(out.keys + k, b.keys + j, (nb - j) * sizeof(int64_t));
+    memcpy(out.vals + k, b.vals + j, (nb - j) * sizeof(void *));
+}
+
+#if KEYSORT_HAVE_AVX2
+
+/* Leave the lower of each pair of keys in `ak`, moving values along */
+__attribute__((target("avx2"))) static inline void minmax(__m256i *ak,
+                                                          __m256i *av,
+                                                          __m256i *bk,
+                                                          __m256i *bv)
+{
+    const __m256i gt = _mm256_cmpgt_epi64(*ak, *bk);
+    const __m256i lk = _mm256_blendv_epi8(*ak, *bk, gt);
+    const __m256i lv = _mm256_blendv_epi8(*av, *bv, gt);
+    *bk = _mm256_blendv_epi8(*bk, *ak, gt);
+    *bv = _mm256_blendv_epi8(*bv, *av, gt);
+    *ak = lk;
+    *av = lv;
+}
+
+/*
+ * Merge two sorted quadruples by a bitonic network, leaving the lower four
+ * in `lk` and the upper four in `hk`, both sorted
+ */
+__attribute__((target("avx2"))) static inline void bitonic_merge4(
+    __m256i *lk,
+    __m256i *lv,
+    __m256i *hk,
+    __m256i *hv)
+{
+    __m256i uk, uv, wk, wv;
+
+    /* Reversing the upper quadruple makes the eight keys bitonic */
+    *hk = _mm256_permute4x64_epi64(*hk, _MM_SHUFFLE(0, 1, 2, 3));
+    *hv = _mm256_permute4x64_epi64(*hv, _MM_SHUFFLE(0, 1, 2, 3));
+    minmax(lk, lv, hk, hv);
+
+    /* Compare at distance 2 within each quadruple */
+    uk = _mm256_permute2x128_si256(*lk, *hk, 0x20);
+    uv = _mm256_permute2x128_si256(*lv, *hv, 0x20);
+    wk = _mm256_permute2x128_si256(*lk, *hk, 0x31);
+    wv = _mm256_permute2x128_si256(*lv, *hv, 0x31);
+    minmax(&uk, &uv, &wk, &wv);
+
+    /* Compare at distance 1 */
+    *lk = _mm256_unpacklo_epi64(uk, wk);
+    *lv = _mm256_unpacklo_epi64(uv, wv);
+    *hk = _mm256_unpackhi_epi64(uk, wk);
+    *hv = _mm256_unpackhi_epi64(uv, wv);
+    minmax(lk, lv, hk, hv);
+
+    /* Interleave back into order */
+    uk = _mm256_unpacklo_epi64(*lk, *hk);
+    uv = _mm256_unpacklo_epi64(*lv, *hv);
+    wk = _mm256_unpackhi_epi64(*lk, *hk);
+    wv = _mm256_unpackhi_epi64(*lv, *hv);
+    *lk = _mm256_permute2x128_si256(uk, wk, 0x20);
+    *lv = _mm256_permute2x128_si256(uv, wv, 0x20);
+    *hk = _mm256_permute2x128_si256(uk, wk, 0x31);
+    *hv = _mm256_permute2x128_si256(uv, wv, 0x31);
+}
+
+/*
+ * Merge like `merge_scalar()`, four entries at a time.
+ * The next quadruple comes from the run whose next key is lower, so that
+ * the lower half of each merge is final.  Once that run has less than four
+ * entries left, the upper half is merged with the rest by scalar loops.
+ */
+__attribute__((target("avx2"))) static void merge_avx2(kv_t a,
+                                                       size_t na,
+                                                       kv_t b,
+                                                       size_t nb,
+                                                       kv_t out)
+{
+    __m256i lk, lv, hk, hv;
+    int64_t rk[4];
+    void *rv[4];
+    size_t i = 4, j = 4, k = 0, x = 0;
+
+    if (na < 4 || nb < 4) {
+        merge_scalar(a, na, b, nb, out);
+        return;
+    }
+
+    lk = _mm256_loadu_si256((const __m256i *) a.keys);
+    lv = _mm256_loadu_si256((const __m256i *) a.vals);
+    hk = _mm256_loadu_si256((const __m256i *) b.keys);
+    hv = _mm256_loadu_si256((const __m256i *) b.vals);
+    for (;;) {
+        bitonic_merge4(&lk, &lv, &hk, &hv);
+        _mm256_storeu_si256((__m256i *) (out.keys + k), lk);
+        _mm256_storeu_si256((__m256i *) (out.vals + k), lv);
+        k += 4;
+
+        if (i < na && (j == nb || a.keys[i] <= b.keys[j])) {
+            if (na - i < 4)
+                break;
+            lk = _mm256_loadu_si256((const __m256i *) (a.keys + i));
+            lv = _mm256_loadu_si256((const __m256i *) (a.vals + i));
+            i += 4;
+        } else if (j < nb) {
+            if (nb - j < 4)
+                break;
+            lk = _mm256_loadu_si256((const __m256i *) (b.keys + j));
+            lv = _mm256_loadu_si256((const __m256i *) (b.vals + j));
+            j += 4;
+        } else {
+            break;
+        }
+    }
+
+    /* Take the upper half in order among the rest of both runs */
+    _mm256_storeu_si256((__m256i *) rk, hk);
+    _mm256_storeu_si256((__m256i *) rv, hv);
+    while (x < 4) {
+        if (i < na && a.keys[i] < rk[x] &&
+            (j == nb || a.keys[i] <= b.keys[j])) {
+            out.keys[k] = a.keys[i];
+            out.vals[k++] = a.vals[i++];
+        } else if (j < nb && b.keys[j] < rk[x]) {
+            out.keys[k] = b.keys[j];
+            out.vals[k++] = b.vals[j++];
+        } else {
+            out.keys[k] = rk[x];
+            out.vals[k++] = rv[x++];
+        }
+    }
+    merge_scalar(kv_at(a, i), na - i, kv_at(b, j), nb - j, kv_at(out, k));
+}
+
+#else
+
+#define merge_avx2 merge_scalar
+
+#endif /* KEYSORT_HAVE_AVX2 */
+
+/*
+ * Sort blocks by insertion, then merge them bottom-up, swapping the roles
+ * of the arrays and the working space at each pass
+ */
+void keysort(int64_t *keys,
+             void **vals,
+             size_t n,
+             int64_t *tmp_keys,
+             void **tmp_vals)
+{
+    kv_t src = {keys, vals};
+    kv_t dst = {tmp_keys, tmp_vals};
+    const bool simd = keysort_kernel() == KEYSORT_AVX2;
+
+    for (size_t i = 0; i < n; i += KEYSORT_BLOCK)
+        block_sort(kv_at(src, i),
+                   (n - i < KEYSORT_BLOCK) ? n - i : KEYSORT_BLOCK);
+
+    for (size_t width = KEYSORT_BLOCK; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            const size_t mid = (n - lo > width) ? lo + width : n;
+            const size_t hi = (n - mid > width) ? mid + width : n;
+            if (simd)
+                merge_avx2(kv_at(src, lo), mid - lo, kv_at(src, mid), hi - mid,
+                           kv_at(dst, lo));
+            else
+                merge_scalar(kv_at(src, lo), mid - lo, kv_at(src, mid),
+                             hi - mid, kv_at(dst, lo));
+        }
+        const kv_t tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src.keys != keys) {
+        memcpy(keys, src.keys, n * sizeof(int64_t));
+        memcpy(vals, src.vals, n * sizeof(void *));
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef LAB0_KEYSORT_H
+#define LAB0_KEYSORT_H
+
+/*
+ * This program implements a merge sort of values by 64-bit keys.
+ *
+ * The keys and the values live in separate arrays, so that a merge step can
+ * compare and move four keys with their values at once.  On CPUs with AVX2,
+ * sorted blocks of four are merged by a bitonic network; elsewhere, and for
+ * the remainders, a scalar loop does the same.
+ * Equal keys come out in unspecified order.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Kernel used to merge */
+typedef enum {
+    KEYSORT_OFF,    /* Callers sort by other means */
+    KEYSORT_SCALAR, /* Scalar merge loop */
+    KEYSORT_AVX2,   /* Bitonic network on AVX2 registers */
+} keysort_kernel_t;
+
+/*
+ * Select the kernel. AVX2 falls back to the scalar loop if the CPU does not
+ * support it.
+ * Return the kernel in use.
+ */
+keysort_kernel_t keysort_set_kernel(keysort_kernel_t kernel);
+
+/*
+ * Return the kernel in use, which is AVX2 by default if the CPU supports it,
+ * and the scalar loop otherwise.
+ */
+keysort_kernel_t keysort_kernel();
+
+/*
+ * Sort n keys in ascending order, moving vals[i] along with keys[i].
+ * tmp_keys and tmp_vals are working space of n entries each.
+ */
+void keysort(int64_t *keys,
+             void **vals,
+             size_t n,
+             int64_t *tmp_keys,
+             void **tmp_vals);
+
+#endif /* LAB0_KEYSORT_H */
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+#include "hash.h"
+#include "lru.h"
+
+/* Return the key of an element for the index */
+static const char *lru_ele_key(const void *item)
+{
+    return ((const lru_ele_t *) item)->value;
+}
+
+/*
+ * Create empty recency list holding at most `capacity` strings.
+ * A capacity of 0 means unlimited.
+ * Return NULL if could not allocate space.
+ */
+lru_t *lru_new(size_t capacity)
+{
+    lru_t *c = malloc(sizeof(lru_t));
+    if (!c)
+        return NULL;
+
+    if (!hash_init(&c->index, capacity, lru_ele_key)) {
+        free(c);
+        return NULL;
+    }
+    c->head = c->tail = NULL;
+    c->size = 0;
+    c->capacity = capacity;
+    c->hits = c->misses = 0;
+    return c;
+}
+
+/* Free all storage used by recency list */
+void lru_free(lru_t *c)
+{
+    if (!c)
+        return;
+
+    for (lru_ele_t *k = c->head; k;) {
+        lru_ele_t *const next = k->next;
+        free(k->value);
+        free(k);
+        k = next;
+    }
+    hash_destroy(&c->index);
+    free(c);
+}
+
+/* Unlink `e` from the list */
+static void lru_unlink(lru_t *c, lru_ele_t *e)
+{
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        c->head = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        c->tail = e->prev;
+}
+
+/* Link `e` at head of the list */
+static void lru_link_head(lru_t *c, lru_ele_t *e)
+{
+    e->prev = NULL;
+    e->next = c->head;
+    if (c->head)
+        c->head->prev = e;
+    else
+        c->tail = e;
+    c->head = e;
+}
+
+/*
+ * Mark string `s` as the most recently used one.
+ * Move its element to head if present, or insert a copy of `s` at head.
+ * Inserting into a full list evicts the tail first.
+ */
+lru_status_t lru_touch(lru_t *c, const char *s)
+{
+    lru_ele_t *e;
+    uint32_t hv;
+    size_t len;
+
+    if (!c)
+        return LRU_FAIL;
+
+    hv = hash_str(s);
+    e = hash_find(&c->index, s, hv);
+    if (e) {
+        if (e != c->head) {
+            lru_unlink(c, e);
+            lru_link_head(c, e);
+        }
+        ++c->hits;
+        return LRU_HIT;
+    }
+
+    if (c->capacity && c->size >= c->capacity)
+        lru_evict_tail(c, NULL, 0);
+
+    e = malloc(sizeof(lru_ele_t));
+    if (!e)
+        return LRU_FAIL;
+    len = strlen(s) + 1;
+    e->value = malloc(len);
+    if (!e->value) {
+        free(e);
+        return LRU_FAIL;
+    }
+    memcpy(e->value, s, len);
+    e->hash = hv;
+    if (!hash_insert(&c->index, e, hv)) {
+        free(e->value);
+        free(e);
+        return LRU_FAIL;
+    }
+
+    lru_link_head(c, e);
+    ++c->size;
+    ++c->misses;
+    return LRU_MISS;
+}
+
+/*
+ * Attempt to remove the least recently used element.
+ * Return true if successful.
+ * Return false if `c` is NULL or empty.
+ * If `sp` is non-NULL and an element is removed, copy the removed string to
+ * `*sp` (up to a maximum of `bufsize`-1 characters, plus a null terminator.)
+ */
+bool lru_evict_tail(lru_t *c, char *sp, size_t bufsize)
+{
+    lru_ele_t *node;
+    if (!c || !c->tail)
+        return false;
+
+    node = c->tail;
+    if (sp && bufsize) {
+        const size_t len = strnlen(node->value, bufsize - 1);
+        memcpy(sp, node->value, len);
+        sp[len] = '\0';
+    }
+
+    hash_remove(&c->index, node, node->hash);
+    lru_unlink(c, node);
+    free(node->value);
+    free(node);
+
+    --c->size;
+    return true;
+}
+
+/*
+ * Return number of elements in recency list.
+ * Return 0 if `c` is NULL or empty
+ */
+size_t lru_size(const lru_t *c)
+{
+    return (c) ? c->size : 0;
+}
@@ -0,0 +1,83 @@
+#ifndef LAB0_LRU_H
+#define LAB0_LRU_H
+
+/*
+ * This program implements the recency list of a string cache.
+ *
+ * It pairs a doubly-linked list, ordered from the most recently used string
+ * to the least recently used one, with a hash index from strings to list
+ * elements, so that every operation takes O(1) time.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash.h"
+
+/* Data structure declarations */
+
+/* Doubly-linked list element */
+typedef struct LRUELE {
+    char *value;         /* Owned copy of the string */
+    struct LRUELE *prev; /* The more recently used neighbor */
+    struct LRUELE *next; /* The less recently used neighbor */
+    uint32_t hash;       /* The hash value of the string */
+} lru_ele_t;
+
+/* Recency list structure */
+typedef struct {
+    lru_ele_t *head;    /* The most recently used element */
+    lru_ele_t *tail;    /* The least recently used element */
+    size_t size;        /* The number of elements */
+    size_t capacity;    /* The maximum number of elements, 0 if unlimited */
+    hash_table_t index; /* Strings to elements */
+    size_t hits;        /* Touches of strings already present */
+    size_t misses;      /* Touches of strings not present */
+} lru_t;
+
+/* Result of touching a string */
+typedef enum {
+    LRU_HIT,  /* The string was present and is moved to head */
+    LRU_MISS, /* The string is inserted at head */
+    LRU_FAIL, /* The list is NULL or could not allocate space */
+} lru_status_t;
+
+/* Operations on recency list */
+
+/*
+ * Create empty recency list holding at most capacity strings.
+ * A capacity of 0 means unlimited.
+ * Return NULL if could not allocate space.
+ */
+lru_t *lru_new(size_t capacity);
+
+/*
+ * Free ALL storage used by recency list.
+ * No effect if c is NULL
+ */
+void lru_free(lru_t *c);
+
+/*
+ * Mark string s as the most recently used one.
+ * Move its element to head if present, or insert a copy of s at head.
+ * Inserting into a full list evicts the tail first.
+ */
+lru_status_t lru_touch(lru_t *c, const char *s);
+
+/*
+ * Attempt to remove the least recently used element.
+ * Return true if successful.
+ * Return false if c is NULL or empty.
+ * If sp is non-NULL and an element is removed, copy the removed string to *sp
+ * (up to a maximum of bufsize-1 characters, plus a null terminator.)
+ */
+bool lru_evict_tail(lru_t *c, char *sp, size_t bufsize);
+
+/*
+ * Return number of elements in recency list.
+ * Return 0 if c is NULL or empty
+ */
+size_t lru_size(const lru_t *c);
+
+#endif /* LAB0_LRU_H */
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compare.h"
+#include "harness.h"
+#include "pqueue.h"
+
+/*
+ * Create empty priority queue ordered by `cmp`.
+ * Return NULL if could not allocate space.
+ */
+pqueue_t *pq_new(cmp_func_t cmp)
+{
+    pqueue_t *pq = malloc(sizeof(pqueue_t));
+    if (pq) {
+        pq->root = NULL;
+        pq->size = 0;
+        pq->cmp = cmp;
+    }
+    return pq;
+}
+
+/* Free all storage used by priority queue */
+void pq_free(pqueue_t *pq)
+{
+    if (!pq)
+        return;
+
+    /*
+     * Rotate children into the sibling chain until the current element
+     * has no child, so that the heap is freed without recursion
+     */
+    for (pq_ele_t *k = pq->root; k;) {
+        if (k->child) {
+            pq_ele_t *const child = k->child;
+            k->child = child->sibling;
+            child->sibling = k;
+            k = child;
+        } else {
+            pq_ele_t *const next = k->sibling;
+            free(k->value);
+            free(k);
+            k = next;
+        }
+    }
+    free(pq);
+}
+
+/*
+ * Link the two heaps `a` and `b` by making the larger root a child of the
+ * smaller one. Return the new root.
+ * The roots should not have siblings.
+ */
+static pq_ele_t *pq_meld(pq_ele_t *a, pq_ele_t *b, cmp_func_t cmp)
+{
+    if (!a)
+        return b;
+    if (!b)
+        return a;
+
+    if (cmp(b->value, a->value) < 0) {
+        pq_ele_t *const tmp = a;
+        a = b;
+        b = tmp;
+    }
+    b->sibling = a->child;
+    a->child = b;
+    return a;
+}
+
+/*
+ * Meld the sibling chain starting with `first` into a single heap using the
+ * two-pass pairing strategy. Return the new root.
+ */
+static pq_ele_t *pq_merge_pairs(pq_ele_t *first, cmp_func_t cmp)
+{
+    pq_ele_t *pairs = NULL; /* Melded pairs, in reverse order */
+    pq_ele_t *root = NULL;
+
+    /* First pass: meld the siblings pairwise from left to right */
+    while (first) {
+        pq_ele_t *const a = first;
+        pq_ele_t *const b = first->sibling;
+        pq_ele_t *pair;
+
+        if (b) {
+            first = b->sibling;
+            a->sibling = b->sibling = NULL;
+            pair = pq_meld(a, b, cmp);
+        } else {
+            first = NULL;
+            pair = a;
+        }
+        pair->sibling = pairs;
+        pairs = pair;
+    }
+
+    /* Second pass: meld the pairs from right to left */
+    while (pairs) {
+        pq_ele_t *const next = pairs->sibling;
+        pairs->sibling = NULL;
+        root = pq_meld(root, pairs, cmp);
+        pairs = next;
+    }
+    return root;
+}
+
+/*
+ * Attempt to insert a copy of string `s`.
+ * Return true if successful.
+ * Return false if `pq` is NULL or could not allocate space.
+ */
+bool pq_insert(pqueue_t *pq, const char *s)
+{
+    pq_ele_t *newh;
+    size_t len;
+    if (!pq)
+        return false;
+
+    newh = malloc(sizeof(pq_ele_t));
+    if (!newh)
+        return false;
+    len = strlen(s) + 1;
+    newh->value = malloc(len);
+    if (!newh->value) {
+        free(newh);
+        return false;
+    }
+    memcpy(newh->value, s, len);
+    newh->child = newh->sibling = NULL;
+
+    pq->root = pq_meld(pq->root, newh, pq->cmp);
+    ++pq->size;
+    return true;
+}
+
+/*
+ * Return the minimum string without removing it.
+ * Return NULL if `pq` is NULL or empty.
+ */
+const char *pq_peek_min(const pqueue_t *pq)
+{
+    return (pq && pq->root) ? pq->root->value : NULL;
+}
+
+/*
+ * Attempt to remove the minimum element.
+ * Return true if successful.
+ * Return false if `pq` is NULL or empty.
+ * If `sp` is non-NULL and an element is removed, copy the removed string to
+ * `*sp` (up to a maximum of `bufsize`-1 characters, plus a null terminator.)
+ */
+bool pq_remove_min(pqueue_t *pq, char *sp, size_t bufsize)
+{
+    pq_ele_t *node;
+    if (!pq || !pq->root)
+        return false;
+
+    node = pq->root;
+    if (sp && bufsize) {
+        const size_t len = strnlen(node->value, bufsize - 1);
+        memcpy(sp, node->value, len);
+        sp[len] = '\0';
+    }
+
+    pq->root = pq_merge_pairs(node->child, pq->cmp);
+    free(node->value);
+    free(node);
+
+    --pq->size;
+    return true;
+}
+
+/*
+ * Return number of elements in priority queue.
+ * Return 0 if `pq` is NULL or empty
+ */
+size_t pq_size(const pqueue_t *pq)
+{
+    return (pq) ? pq->size : 0;
+}
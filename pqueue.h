@@ -0,0 +1,76 @@
+#ifndef LAB0_PQUEUE_H
+#define LAB0_PQUEUE_H
+
+/*
+ * This program implements a priority queue of strings.
+ *
+ * It uses a pairing heap ordered by one of the comparison functions of
+ * compare.h, so that insertion takes O(1) time and removal of the minimum
+ * takes O(log n) amortized time.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "compare.h"
+
+/* Data structure declarations */
+
+/* Pairing heap element */
+typedef struct PQELE {
+    char *value;           /* Owned copy of the string */
+    struct PQELE *child;   /* The leftmost child */
+    struct PQELE *sibling; /* The next sibling to the right */
+} pq_ele_t;
+
+/* Priority queue structure */
+typedef struct {
+    pq_ele_t *root; /* The minimum element */
+    size_t size;    /* The number of elements */
+    cmp_func_t cmp; /* The ordering of elements */
+} pqueue_t;
+
+/* Operations on priority queue */
+
+/*
+ * Create empty priority queue ordered by cmp.
+ * Return NULL if could not allocate space.
+ * Argument cmp should not be NULL.
+ */
+pqueue_t *pq_new(cmp_func_t cmp);
+
+/*
+ * Free ALL storage used by priority queue.
+ * No effect if pq is NULL
+ */
+void pq_free(pqueue_t *pq);
+
+/*
+ * Attempt to insert a copy of string s.
+ * Return true if successful.
+ * Return false if pq is NULL or could not allocate space.
+ */
+bool pq_insert(pqueue_t *pq, const char *s);
+
+/*
+ * Return the minimum string without removing it.
+ * Return NULL if pq is NULL or empty.
+ */
+const char *pq_peek_min(const pqueue_t *pq);
+
+/*
+ * Attempt to remove the minimum element.
+ * Return true if successful.
+ * Return false if pq is NULL or empty.
+ * If sp is non-NULL and an element is removed, copy the removed string to *sp
+ * (up to a maximum of bufsize-1 characters, plus a null terminator.)
+ */
+bool pq_remove_min(pqueue_t *pq, char *sp, size_t bufsize);
+
+/*
+ * Return number of elements in priority queue.
+ * Return 0 if pq is NULL or empty
+ */
+size_t pq_size(const pqueue_t *pq);
+
+#endif /* LAB0_PQUEUE_H */
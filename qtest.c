@@ -1,11 +1,15 @@
 /* Implementation of testing code for queue code */
 
+#include <ctype.h>
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
 #include <signal.h>
 #include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <time.h>
@@ -30,6 +34,14 @@
  */
 #include "queue.h"
 
+#include "allocator.h"
+#include "aqueue.h"
+#include "keysort.h"
+#include "lru.h"
+#include "pqueue.h"
+#include "reclaim.h"
+#include "u64queue.h"
+
 #include "compare.h" /* comparison functions */
 
 #include "console.h"
@@ -45,6 +57,11 @@
 #define BIG_QUEUE 30
 static int big_queue_size = BIG_QUEUE;
 
+/* How many values are fetched at once when scanning the queue */
+#define ITER_BATCH 64
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
 /* Global variables */
 
 /* Queue being tested */
@@ -53,6 +70,47 @@ static queue_t *q = NULL;
 /* Number of elements in queue */
 static size_t qcnt = 0;
 
+/*
+ * Other queues being tested and their numbers of elements, indexed by the
+ * "queue" option.  The slot of the current queue is held in `q` and `qcnt`.
+ */
+#define MAX_QUEUES 16
+static queue_t *queues[MAX_QUEUES];
+static size_t qcnts[MAX_QUEUES];
+static int queue_idx = 0;
+
+/* Priority queue being tested, and the number of its elements */
+static pqueue_t *pq = NULL;
+static size_t pqcnt = 0;
+
+/* Recency list being tested */
+static lru_t *lru = NULL;
+
+/* Queue of integers being tested */
+static u64q_t *uq = NULL;
+static aqueue_t *aq = NULL;
+
+/*
+ * Owners the blocks of each tested structure are counted for: queues by
+ * their number, the other structures after them
+ */
+enum {
+    OWNER_PQ = MAX_QUEUES,
+    OWNER_LRU,
+    OWNER_U64,
+    OWNER_AQ,
+};
+
+/*
+ * Group of each queue number.  Queues which took elements from each other by
+ * merge or split hold each other's blocks, so they are checked together once
+ * all of them are freed.  Each group is numbered after one of its queues.
+ */
+static int qgroups[MAX_QUEUES];
+
+/* Blocks of each owner already reported as leaked */
+static size_t leaked[ALLOC_OWNERS];
+
 /* How many times can queue operations fail */
 static int fail_limit = BIG_QUEUE;
 static int fail_count = 0;
@@ -66,21 +124,317 @@ static const char charset[] = "abcdefghijklmnopqrstuvwxyz";
 /* Comparison method */
 static int cmp_func_idx = 0;
 
+/* Whether a full bounded queue drops its head on tail insertion */
+static int overwrite = 0;
+
+/* Whether new queues keep a hash index of their values */
+static int use_index = 0;
+
+/* Kibibytes of elements sorted in memory at once, 0 if unlimited */
+static int sort_budget = 0;
+
+/* Number of elements kept in memory, beyond which they spill, 0 if never */
+static int spill_limit = 0;
+
+/* Kernel of sorting by key prefixes, as in keysort_kernel_t */
+static int sort_kernel = KEYSORT_AVX2;
+
+/* Distance between elements indexed for positional access, 0 if none */
+static int segments = 0;
+
+/* Source of the memory of elements of new queues, as in q_huge_t */
+static int huge_pages = Q_HUGE_OFF;
+
+/* Allocators new queues take their elements from */
+typedef enum {
+    ALLOC_HARNESS, /* malloc of the harness */
+    ALLOC_SYSTEM,  /* alloc_system() */
+    ALLOC_BUMP,    /* alloc_bump_new() */
+    ALLOC_POOL,    /* alloc_pool_new() */
+} alloc_kind_t;
+
+/* Allocator of new unbounded queues, as in alloc_kind_t */
+static int alloc_kind = ALLOC_HARNESS;
+
+/* Whether the allocator of new queues checks its blocks */
+static int alloc_track = 1;
+
+/* Misuses of tracked allocators reported so far */
+static size_t alloc_errors = 0;
+
+/* Errors of freeing queues in the background reported so far */
+static size_t reclaim_errs = 0;
+
 /* Forward declarations */
 static bool show_queue(int vlevel);
+static bool check_sorted(cmp_func_t cmp);
 static bool do_new(int argc, char *argv[]);
 static bool do_free(int argc, char *argv[]);
 static bool do_insert_head(int argc, char *argv[]);
 static bool do_insert_tail(int argc, char *argv[]);
+static bool do_insert_sorted(int argc, char *argv[]);
+static bool do_lower_bound(int argc, char *argv[]);
 static bool do_remove_head(int argc, char *argv[]);
 static bool do_remove_head_quiet(int argc, char *argv[]);
+static bool do_insert_head_bytes(int argc, char *argv[]);
+static bool do_insert_tail_bytes(int argc, char *argv[]);
+static bool do_remove_head_bytes(int argc, char *argv[]);
+static bool do_peek(int argc, char *argv[]);
 static bool do_reverse(int argc, char *argv[]);
 static bool do_size(int argc, char *argv[]);
 static bool do_sort(int argc, char *argv[]);
 static bool do_show(int argc, char *argv[]);
+static bool do_merge(int argc, char *argv[]);
+static bool do_dedup(int argc, char *argv[]);
+static bool do_group(int argc, char *argv[]);
+static bool do_mem(int argc, char *argv[]);
+static bool do_drain(int argc, char *argv[]);
+static bool do_contains(int argc, char *argv[]);
+static bool do_count(int argc, char *argv[]);
+static bool do_at(int argc, char *argv[]);
+static bool do_split(int argc, char *argv[]);
+static bool do_compact(int argc, char *argv[]);
+static bool do_pq_new(int argc, char *argv[]);
+static bool do_pq_free(int argc, char *argv[]);
+static bool do_pq_insert(int argc, char *argv[]);
+static bool do_pq_remove(int argc, char *argv[]);
+static bool do_pq_remove_quiet(int argc, char *argv[]);
+static bool show_pqueue(int vlevel);
+static bool do_lru_new(int argc, char *argv[]);
+static bool do_lru_free(int argc, char *argv[]);
+static bool do_lru_touch(int argc, char *argv[]);
+static bool do_lru_evict(int argc, char *argv[]);
+static bool do_lru_zipf(int argc, char *argv[]);
+static bool show_lru(int vlevel);
+static bool do_u64_new(int argc, char *argv[]);
+static bool do_u64_free(int argc, char *argv[]);
+static bool do_u64_insert_tail(int argc, char *argv[]);
+static bool do_u64_remove(int argc, char *argv[]);
+static bool do_u64_reverse(int argc, char *argv[]);
+static bool do_u64_sort(int argc, char *argv[]);
+static bool show_u64queue(int vlevel);
+static bool do_aq_new(int argc, char *argv[]);
+static bool do_aq_free(int argc, char *argv[]);
+static bool do_aq_insert_head(int argc, char *argv[]);
+static bool do_aq_insert_tail(int argc, char *argv[]);
+static bool do_aq_remove(int argc, char *argv[]);
+static bool do_aq_reverse(int argc, char *argv[]);
+static bool do_aq_sort(int argc, char *argv[]);
+static bool show_aqueue(int vlevel);
 
 static void queue_init();
 
+static void time_limit_setter(int oldval)
+{
+    if (time_limit < 0) {
+        report(1, "Time limit must not be negative");
+        time_limit = oldval;
+    }
+}
+
+static void overwrite_setter(int oldval)
+{
+    q_set_overwrite(q, overwrite);
+}
+
+/* Build or free the hash index of the current queue */
+static void index_setter(int oldval)
+{
+    if (qcnt > big_queue_size)
+        set_cautious_mode(false);
+    if (q && !q_set_index(q, use_index))
+        report(1, "Could not build hash index");
+    set_cautious_mode(true);
+}
+
+static void sort_budget_setter(int oldval)
+{
+    if (sort_budget < 0) {
+        report(1, "Sort budget must not be negative");
+        sort_budget = oldval;
+        return;
+    }
+    q_set_sort_budget(q, (size_t) sort_budget << 10);
+}
+
+static void sort_kernel_setter(int oldval)
+{
+    if (sort_kernel < KEYSORT_OFF || sort_kernel > KEYSORT_AVX2) {
+        report(1, "Sort kernel must be in [%d, %d]", KEYSORT_OFF, KEYSORT_AVX2);
+        sort_kernel = oldval;
+        return;
+    }
+    if (keysort_set_kernel(sort_kernel) != sort_kernel) {
+        report(1, "AVX2 is not supported; sorting keys with scalar loops");
+        sort_kernel = KEYSORT_SCALAR;
+    }
+}
+
+static void spill_setter(int oldval)
+{
+    if (spill_limit < 0) {
+        report(1, "Spill limit must not be negative");
+        spill_limit = oldval;
+        return;
+    }
+    if (qcnt > big_queue_size)
+        set_cautious_mode(false);
+    if (q && !q_capacity(q) && !q_set_spill(q, spill_limit))
+        report(1, "Could not set spill limit");
+    set_cautious_mode(true);
+}
+
+/* Build or drop the segment index of the current queue */
+static void segments_setter(int oldval)
+{
+    if (segments < 0) {
+        report(1, "Segment distance must not be negative");
+        segments = oldval;
+        return;
+    }
+    if (q && !q_set_segments(q, segments))
+        report(1, "Could not build segment index");
+}
+
+/* Allocate the next elements of the current queue from huge pages or not */
+static void huge_pages_setter(int oldval)
+{
+    if (huge_pages < Q_HUGE_OFF || huge_pages > Q_HUGE_TLB) {
+        report(1, "Huge page mode must be in [%d, %d]", Q_HUGE_OFF,
+               Q_HUGE_TLB);
+        huge_pages = oldval;
+        return;
+    }
+    if (q && !q_capacity(q) && !q_set_huge_pages(q, huge_pages))
+        report(1, "Could not allocate from huge pages");
+}
+
+static void alloc_kind_setter(int oldval)
+{
+    if (alloc_kind < ALLOC_HARNESS || alloc_kind > ALLOC_POOL) {
+        report(1, "Allocator must be in [%d, %d]", ALLOC_HARNESS, ALLOC_POOL);
+        alloc_kind = oldval;
+    }
+}
+
+/*
+ * Create the allocator selected for a new queue, tracked if asked for.
+ * Return NULL if the harness allocates, or could not allocate space.
+ */
+static allocator_t *alloc_new()
+{
+    allocator_t *a = NULL;
+
+    switch (alloc_kind) {
+    case ALLOC_SYSTEM:
+        a = alloc_system();
+        break;
+    case ALLOC_BUMP:
+        a = alloc_bump_new();
+        break;
+    case ALLOC_POOL:
+        a = alloc_pool_new();
+        break;
+    default:
+        return NULL;
+    }
+    if (!a)
+        report(1, "Could not create allocator");
+    return (a && alloc_track) ? alloc_tracked_new(a) : a;
+}
+
+/*
+ * Read the spilled elements of `sq` back before an operation which must not
+ * allocate.
+ * Return false if could not allocate space.
+ */
+static bool unspill(queue_t *sq)
+{
+    if (!sq || q_unspill(sq))
+        return true;
+    report(1, "ERROR: Could not read spilled elements back");
+    return false;
+}
+
+/*
+ * Forbid allocation while operating on a bounded queue, which must not
+ * allocate once created, unless its hash index needs to
+ */
+static void set_bounded_mode(bool on)
+{
+    if (q_capacity(q) && !q_has_index(q))
+        set_noallocate_mode(on);
+}
+
+/* Park the current queue in its slot and take the selected one */
+static void queue_setter(int oldval)
+{
+    if (queue_idx < 0 || queue_idx >= MAX_QUEUES) {
+        report(1, "Queue number must be in [0, %d]", MAX_QUEUES - 1);
+        queue_idx = oldval;
+        return;
+    }
+
+    queues[oldval] = q;
+    qcnts[oldval] = qcnt;
+    q = queues[queue_idx];
+    qcnt = qcnts[queue_idx];
+    queues[queue_idx] = NULL;
+    qcnts[queue_idx] = 0;
+    set_allocation_owner(queue_idx);
+}
+
+/* Put the queues of numbers `a` and `b` in the same group */
+static void queue_join(int a, int b)
+{
+    const int from = qgroups[b];
+    for (int i = 0; i < MAX_QUEUES; i++) {
+        if (qgroups[i] == from)
+            qgroups[i] = qgroups[a];
+    }
+}
+
+/*
+ * Commands of the structures other than queues, run with the blocks they
+ * allocate counted for their structure
+ */
+#define MAX_OWNED_CMDS 32
+static struct {
+    char *name;
+    cmd_function operation;
+    int owner;
+} owned_cmds[MAX_OWNED_CMDS];
+static int owned_cmd_cnt = 0;
+
+static bool do_owned(int argc, char *argv[])
+{
+    for (int i = 0; i < owned_cmd_cnt; i++) {
+        if (strcmp(argv[0], owned_cmds[i].name))
+            continue;
+        set_allocation_owner(owned_cmds[i].owner);
+        bool ok = owned_cmds[i].operation(argc, argv);
+        set_allocation_owner(queue_idx);
+        return ok;
+    }
+    return false;
+}
+
+static void add_owned_cmd(char *name,
+                          cmd_function operation,
+                          char *documentation,
+                          int owner)
+{
+    if (owned_cmd_cnt == MAX_OWNED_CMDS) {
+        report_event(MSG_FATAL, "Exceeded limit on owned commands");
+        return;
+    }
+    owned_cmds[owned_cmd_cnt].name = name;
+    owned_cmds[owned_cmd_cnt].operation = operation;
+    owned_cmds[owned_cmd_cnt].owner = owner;
+    owned_cmd_cnt++;
+    add_cmd(name, do_owned, documentation);
+}
+
 static void compare_setter(int oldval)
 {
     printf("Will use %s for sorting.\n", cmp_get_func_str(cmp_func_idx));
@@ -88,31 +442,189 @@ static void compare_setter(int oldval)
 
 static void console_init()
 {
-    add_cmd("new", do_new, "                | Create new queue");
-    add_cmd("free", do_free, "                | Delete queue");
+    add_cmd("new", do_new,
+            " [cap len]      | Create new queue.  Optionally bound it to cap "
+            "strings of at most len characters");
+    add_cmd("free", do_free,
+            " [async]        | Delete queue.  Optionally free it in the "
+            "background");
+    add_cmd("drain", do_drain,
+            "                | Wait for queues freed in the background");
     add_cmd("ih", do_insert_head,
             " str [n]        | Insert string str at head of queue n times. "
             "Generate random string(s) if str equals RAND. (default: n == 1)");
     add_cmd("it", do_insert_tail,
             " str [n]        | Insert string str at tail of queue n times. "
             "Generate random string(s) if str equals RAND. (default: n == 1)");
+    add_cmd("is", do_insert_sorted,
+            " str [n]        | Insert string str in ascending order n times. "
+            "Generate random string(s) if str equals RAND. (default: n == 1)");
+    add_cmd("lb", do_lower_bound,
+            " str [val]      | Find first value not less than str.  Optionally "
+            "compare to expected value val");
     add_cmd("rh", do_remove_head,
             " [str]          | Remove from head of queue.  Optionally compare "
             "to expected value str");
-    add_cmd(
-        "rhq", do_remove_head_quiet,
-        "                | Remove from head of queue without reporting value.");
+    add_cmd("rhq", do_remove_head_quiet,
+            " [n]            | Remove from head of queue n times without "
+            "reporting value. (default: n == 1)");
+    add_cmd("ihx", do_insert_head_bytes,
+            " hex [n]        | Insert the bytes given in hexadecimal at head "
+            "of queue n times, no bytes if hex is -. (default: n == 1)");
+    add_cmd("itx", do_insert_tail_bytes,
+            " hex [n]        | Insert the bytes given in hexadecimal at tail "
+            "of queue n times, no bytes if hex is -. (default: n == 1)");
+    add_cmd("rhx", do_remove_head_bytes,
+            " [hex]          | Remove bytes from head of queue.  Optionally "
+            "compare to expected bytes in hexadecimal");
+    add_cmd("peek", do_peek,
+            " [hex]          | Show bytes at head of queue.  Optionally "
+            "compare to expected bytes in hexadecimal");
     add_cmd("reverse", do_reverse, "                | Reverse queue");
-    add_cmd("sort", do_sort, "                | Sort queue in ascending order");
+    add_cmd("sort", do_sort,
+            " [k]            | Sort queue in ascending order.  Optionally "
+            "sort only the k smallest elements to head");
     add_cmd("size", do_size,
             " [n]            | Compute queue size n times (default: n == 1)");
     add_cmd("show", do_show, "                | Show queue contents");
+    add_cmd("dedup", do_dedup,
+            " [hash]         | Delete duplicates from queue sorted by the "
+            "comparison function, or from any queue with hash");
+    add_cmd("mem", do_mem,
+            "                | Report bytes allocated by queue code, their "
+            "peak since last report, and peak resident set size");
+    add_cmd("group", do_group,
+            "                | Make elements holding the same string "
+            "contiguous");
+    add_cmd("contains", do_contains,
+            " str [n]        | Look up string str in queue n times. Generate "
+            "random string(s) if str equals RAND. (default: n == 1)");
+    add_cmd("count", do_count,
+            " str [n]        | Count elements holding string str.  Optionally "
+            "compare to expected number n");
+    add_cmd("at", do_at,
+            " pos [str]      | Find value at position pos from head.  "
+            "Optionally compare to expected value str");
+    add_cmd("split", do_split,
+            " pos n          | Move elements from position pos on to empty "
+            "queue number n");
+    add_cmd("compact", do_compact,
+            " [n]            | Lay elements out contiguously in list order, "
+            "n at a time (default: all at once)");
+    add_cmd("merge", do_merge,
+            "                | Merge all other queues, each sorted, into "
+            "queue");
+    add_owned_cmd("pnew", do_pq_new,
+                  "                | Create new priority queue ordered by the "
+                  "current comparison function", OWNER_PQ);
+    add_owned_cmd("pfree", do_pq_free,
+                  "                | Delete priority queue", OWNER_PQ);
+    add_owned_cmd("pi", do_pq_insert,
+                  " str [n]        | Insert string str into priority queue n "
+                  "times. Generate random string(s) if str equals RAND. "
+                  "(default: n == 1)", OWNER_PQ);
+    add_owned_cmd("pr", do_pq_remove,
+                  " [str]          | Remove minimum from priority queue.  "
+                  "Optionally compare to expected value str", OWNER_PQ);
+    add_owned_cmd("prq", do_pq_remove_quiet,
+                  " [n]            | Remove minimum from priority queue n "
+                  "times without reporting value. (default: n == 1)",
+                  OWNER_PQ);
+    add_owned_cmd("lnew", do_lru_new,
+                  " [cap]          | Create new recency list holding at most "
+                  "cap strings (default: unlimited)", OWNER_LRU);
+    add_owned_cmd("lfree", do_lru_free,
+                  "                | Delete recency list", OWNER_LRU);
+    add_owned_cmd("lt", do_lru_touch,
+                  " str [n]        | Touch string str in recency list n times. "
+                  "Generate random string(s) if str equals RAND. (default: "
+                  "n == 1)", OWNER_LRU);
+    add_owned_cmd("le", do_lru_evict,
+                  " [str]          | Evict least recently used string.  "
+                  "Optionally compare to expected value str", OWNER_LRU);
+    add_owned_cmd("lzipf", do_lru_zipf,
+                  " n keys         | Touch n strings drawn from keys distinct "
+                  "ones with Zipf distribution, and report hits and misses",
+                  OWNER_LRU);
+    add_owned_cmd("unew", do_u64_new,
+                  "                | Create new integer queue", OWNER_U64);
+    add_owned_cmd("ufree", do_u64_free,
+                  "                | Delete integer queue", OWNER_U64);
+    add_owned_cmd("uit", do_u64_insert_tail,
+                  " v [n]          | Insert integer v at tail of integer queue "
+                  "n times. Generate random integer(s) if v equals RAND. "
+                  "(default: n == 1)", OWNER_U64);
+    add_owned_cmd("urh", do_u64_remove,
+                  " [v]            | Remove from head of integer queue.  "
+                  "Optionally compare to expected value v", OWNER_U64);
+    add_owned_cmd("ureverse", do_u64_reverse,
+                  "                | Reverse integer queue", OWNER_U64);
+    add_owned_cmd("usort", do_u64_sort,
+                  "                | Sort integer queue in ascending order",
+                  OWNER_U64);
+    add_owned_cmd("anew", do_aq_new,
+                  "                | Create new arena queue", OWNER_AQ);
+    add_owned_cmd("afree", do_aq_free,
+                  "                | Delete arena queue", OWNER_AQ);
+    add_owned_cmd("aih", do_aq_insert_head,
+                  " str [n]        | Insert string str at head of arena queue "
+                  "n times. Generate random string(s) if str equals RAND. "
+                  "(default: n == 1)", OWNER_AQ);
+    add_owned_cmd("ait", do_aq_insert_tail,
+                  " str [n]        | Insert string str at tail of arena queue "
+                  "n times. Generate random string(s) if str equals RAND. "
+                  "(default: n == 1)", OWNER_AQ);
+    add_owned_cmd("arh", do_aq_remove,
+                  " [str]          | Remove from head of arena queue.  "
+                  "Optionally compare to expected value str", OWNER_AQ);
+    add_owned_cmd("areverse", do_aq_reverse,
+                  "                | Reverse arena queue", OWNER_AQ);
+    add_owned_cmd("asort", do_aq_sort,
+                  "                | Sort arena queue in ascending order",
+                  OWNER_AQ);
     add_param("length", &string_length, "Maximum length of displayed string",
               NULL);
     add_param("malloc", &fail_probability, "Malloc failure probability percent",
               NULL);
     add_param("fail", &fail_limit,
               "Number of times allow queue operations to return false", NULL);
+    add_param("timelimit", &time_limit,
+              "Seconds allowed for each queue operation (0: unlimited)",
+              time_limit_setter);
+    add_param("overwrite", &overwrite,
+              "Whether a full bounded queue drops its head on tail insertion",
+              overwrite_setter);
+    add_param("index", &use_index,
+              "Whether queue keeps a hash index of its values", index_setter);
+    add_param("sortbudget", &sort_budget,
+              "Kibibytes of elements sorted in memory at once, beyond which "
+              "sort goes through a file (0: unlimited)",
+              sort_budget_setter);
+    add_param("spill", &spill_limit,
+              "Number of elements of queue kept in memory, beyond which the "
+              "middle is spilled to a file (0: never)",
+              spill_setter);
+    add_param("sortkernel", &sort_kernel,
+              "How sort orders byte-order comparisons (0: merging lists, "
+              "1: scalar merge of key prefixes, 2: AVX2 merge of key prefixes)",
+              sort_kernel_setter);
+    add_param("segments", &segments,
+              "Distance between elements indexed for access by position "
+              "(0: no index)",
+              segments_setter);
+    add_param("hugepages", &huge_pages,
+              "Where elements are allocated (0: one by one, 1: regions of "
+              "transparent huge pages, 2: regions of reserved huge pages)",
+              huge_pages_setter);
+    add_param("allocator", &alloc_kind,
+              "Allocator of the elements of new queues (0: malloc of the "
+              "harness, 1: system, 2: bump, 3: pool)",
+              alloc_kind_setter);
+    add_param("alloctrack", &alloc_track,
+              "Whether the allocator of new queues checks its blocks", NULL);
+    add_param("queue", &queue_idx,
+              "Number of the queue operated on by queue commands (default: 0)",
+              queue_setter);
 #define CMP_EXPAND_FMT(n) " " #n ": " CMP_FUNC_STR(n)
     add_param("compare", &cmp_func_idx,
               "Comparison function to be used (default: 0)" CMP_EXPAND(),
@@ -120,22 +632,140 @@ static void console_init()
 #undef CMP_EXPAND_FMT
 }
 
+/*
+ * Report blocks of `owners`, `n` of them, which are allocated beyond those
+ * already reported, once their structure named `name` is freed.
+ * Return false if there are any.
+ */
+static bool owned_check(const int *owners, int n, const char *name)
+{
+    size_t bcnt = 0;
+    for (int i = 0; i < n; i++) {
+        const size_t cnt = allocation_owned(owners[i]);
+        if (cnt > leaked[owners[i]])
+            bcnt += cnt - leaked[owners[i]];
+        leaked[owners[i]] = cnt;
+    }
+    if (bcnt > 0) {
+        report(1, "ERROR: Freed %s, but %lu blocks are still allocated", name,
+               bcnt);
+        return false;
+    }
+    return true;
+}
+
+/* Return whether the queue of number `i` is alive */
+static bool queue_alive(int i)
+{
+    return (i == queue_idx) ? q != NULL : queues[i] != NULL;
+}
+
+/*
+ * Report the misuses of tracked allocators since the last check, the errors
+ * of freeing in the background, and the blocks still allocated for each
+ * tested structure which is freed.
+ * Return false if there are any.
+ */
+static bool leak_check()
+{
+    const size_t errors = alloc_tracked_errors();
+    if (errors > alloc_errors) {
+        report(1, "ERROR: Allocators of queues reported %lu error(s)",
+               errors - alloc_errors);
+        alloc_errors = errors;
+        return false;
+    }
+
+    /* Queues freed in the background hold blocks until done */
+    reclaim_drain();
+    const size_t rerrors = reclaim_errors();
+    if (rerrors > reclaim_errs) {
+        report(1, "ERROR: Freeing %lu queue(s) in the background failed",
+               rerrors - reclaim_errs);
+        reclaim_errs = rerrors;
+        return false;
+    }
+
+    bool ok = true;
+    const void *const others[] = {pq, lru, uq, aq};
+    static const char *const names[] = {
+        "priority queue",
+        "recency list",
+        "integer queue",
+        "arena queue",
+    };
+    for (int i = 0; i < 4; i++) {
+        const int owner = OWNER_PQ + i;
+        if (!others[i])
+            ok = owned_check(&owner, 1, names[i]) && ok;
+    }
+
+    /* A group of queues is checked once all of its queues are freed */
+    for (int g = 0; g < MAX_QUEUES; g++) {
+        int members[MAX_QUEUES], n = 0;
+        bool alive = false;
+        for (int i = 0; i < MAX_QUEUES; i++) {
+            if (qgroups[i] == g) {
+                members[n++] = i;
+                alive = alive || queue_alive(i);
+            }
+        }
+        if (!n || alive)
+            continue;
+        ok = owned_check(members, n, "queue") && ok;
+        for (int i = 0; i < n; i++)
+            qgroups[members[i]] = members[i];
+    }
+    return ok;
+}
+
 static bool do_new(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    int capacity = 0, max_strlen = 0;
+    if (argc != 1 && argc != 3) {
+        report(1, "%s needs 0 or 2 arguments", argv[0]);
         return false;
     }
 
+    if (argc == 3) {
+        if (!get_int(argv[1], &capacity) || capacity <= 0) {
+            report(1, "Invalid capacity '%s'", argv[1]);
+            return false;
+        }
+        if (!get_int(argv[2], &max_strlen) || max_strlen < 0) {
+            report(1, "Invalid maximum string length '%s'", argv[2]);
+            return false;
+        }
+    }
+
     bool ok = true;
     if (q) {
         report(3, "Freeing old queue");
-        ok = do_free(argc, argv);
+        ok = do_free(1, argv);
     }
     error_check();
 
-    if (exception_setup(true))
-        q = q_new();
+    if (exception_setup(true)) {
+        allocator_t *const a = (capacity) ? NULL : alloc_new();
+        if (a) {
+            q = q_new_with_allocator(a);
+            if (!q)
+                alloc_destroy(a);
+        } else {
+            q = (capacity) ? q_new_bounded(capacity, max_strlen) : q_new();
+        }
+        q_set_overwrite(q, overwrite);
+        q_set_sort_budget(q, (size_t) sort_budget << 10);
+        if (q && !capacity && spill_limit && !q_set_spill(q, spill_limit))
+            report(1, "Could not set spill limit");
+        if (q && use_index && !q_set_index(q, true))
+            report(1, "Could not build hash index");
+        if (q && segments && !q_set_segments(q, segments))
+            report(1, "Could not build segment index");
+        if (q && !capacity && !a && huge_pages &&
+            !q_set_huge_pages(q, huge_pages))
+            report(1, "Could not allocate from huge pages");
+    }
     exception_cancel();
     qcnt = 0;
     show_queue(3);
@@ -145,8 +775,11 @@ static bool do_new(int argc, char *argv[])
 
 static bool do_free(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    bool async = false;
+    if (argc == 2 && !strcmp(argv[1], "async")) {
+        async = true;
+    } else if (argc != 1) {
+        report(1, "%s takes no arguments or async", argv[0]);
         return false;
     }
 
@@ -157,8 +790,12 @@ static bool do_free(int argc, char *argv[])
 
     if (qcnt > big_queue_size)
         set_cautious_mode(false);
-    if (exception_setup(true))
-        q_free(q);
+    if (exception_setup(true)) {
+        if (async)
+            q_free_async(q);
+        else
+            q_free(q);
+    }
     exception_cancel();
     set_cautious_mode(true);
 
@@ -166,13 +803,21 @@ static bool do_free(int argc, char *argv[])
     qcnt = 0;
     show_queue(3);
 
-    size_t bcnt = allocation_check();
-    if (bcnt > 0) {
-        report(1, "ERROR: Freed queue, but %lu blocks are still allocated",
-               bcnt);
-        ok = false;
+    /* Leave the check to the drain, so that freeing does not wait */
+    if (!async)
+        ok = leak_check() && ok;
+    return ok && !error_check();
+}
+
+static bool do_drain(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
     }
 
+    reclaim_drain();
+    bool ok = leak_check();
     return ok && !error_check();
 }
 /*
@@ -195,7 +840,7 @@ static bool do_insert_head(int argc, char *argv[])
 {
     char *lasts = NULL;
     char randstr_buf[MAX_RANDSTR_LEN];
-    int reps = 1;
+    long reps = 1;
     bool ok = true, need_rand = false;
     if (argc != 2 && argc != 3) {
         report(1, "%s needs 1-2 arguments", argv[0]);
@@ -204,7 +849,7 @@ static bool do_insert_head(int argc, char *argv[])
 
     char *inserts = argv[1];
     if (argc == 3) {
-        if (!get_int(argv[2], &reps)) {
+        if (!get_long(argv[2], &reps)) {
             report(1, "Invalid number of insertions '%s'", argv[2]);
             return false;
         }
@@ -219,12 +864,17 @@ static bool do_insert_head(int argc, char *argv[])
         report(3, "Warning: Calling insert head on null queue");
     error_check();
 
+    set_bounded_mode(true);
     if (exception_setup(true)) {
-        for (int r = 0; ok && r < reps; r++) {
+        for (long r = 0; ok && r < reps; r++) {
             if (need_rand)
                 fill_rand_string(randstr_buf, sizeof(randstr_buf));
-            bool rval = q_insert_head(q, inserts);
-            if (rval) {
+            q_status_t status = q_try_insert_head(q, inserts);
+            if (status == Q_FULL) {
+                report(2, "Queue is full; stop inserting %s", inserts);
+                break;
+            }
+            if (status == Q_OK) {
                 qcnt++;
                 if (!q->head->value) {
                     report(1, "ERROR: Failed to save copy of string in list");
@@ -258,6 +908,7 @@ static bool do_insert_head(int argc, char *argv[])
         }
     }
     exception_cancel();
+    set_bounded_mode(false);
 
     show_queue(3);
     return ok;
@@ -280,7 +931,7 @@ static bool do_insert_tail(int argc, char *argv[])
     }
 
     char randstr_buf[MAX_RANDSTR_LEN];
-    int reps = 1;
+    long reps = 1;
     bool ok = true, need_rand = false;
     if (argc != 2 && argc != 3) {
         report(1, "%s needs 1-2 arguments", argv[0]);
@@ -289,7 +940,7 @@ static bool do_insert_tail(int argc, char *argv[])
 
     char *inserts = argv[1];
     if (argc == 3) {
-        if (!get_int(argv[2], &reps)) {
+        if (!get_long(argv[2], &reps)) {
             report(1, "Invalid number of insertions '%s'", argv[2]);
             return false;
         }
@@ -304,12 +955,20 @@ static bool do_insert_tail(int argc, char *argv[])
         report(3, "Warning: Calling insert tail on null queue");
     error_check();
 
+    /* Spilling frees whole segments of elements */
+    if (q && spill_limit > big_queue_size)
+        set_cautious_mode(false);
+    set_bounded_mode(true);
     if (exception_setup(true)) {
-        for (int r = 0; ok && r < reps; r++) {
+        for (long r = 0; ok && r < reps; r++) {
             if (need_rand)
                 fill_rand_string(randstr_buf, sizeof(randstr_buf));
-            bool rval = q_insert_tail(q, inserts);
-            if (rval) {
+            q_status_t status = q_try_insert_tail(q, inserts);
+            if (status == Q_FULL) {
+                report(2, "Queue is full; stop inserting %s", inserts);
+                break;
+            }
+            if (status == Q_OK) {
                 qcnt++;
                 if (!q->head->value) {
                     report(1, "ERROR: Failed to save copy of string in list");
@@ -330,10 +989,97 @@ static bool do_insert_tail(int argc, char *argv[])
         }
     }
     exception_cancel();
+    set_bounded_mode(false);
+    set_cautious_mode(true);
+    show_queue(3);
+    return ok;
+}
+
+static bool do_insert_sorted(int argc, char *argv[])
+{
+    char randstr_buf[MAX_RANDSTR_LEN];
+    long reps = 1;
+    bool ok = true, need_rand = false;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    char *inserts = argv[1];
+    if (argc == 3) {
+        if (!get_long(argv[2], &reps)) {
+            report(1, "Invalid number of insertions '%s'", argv[2]);
+            return false;
+        }
+    }
+
+    if (!strcmp(inserts, "RAND")) {
+        need_rand = true;
+        inserts = randstr_buf;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling insert sorted on null queue");
+    error_check();
+
+    const cmp_func_t cmp = cmp_get_func(cmp_func_idx);
+    if (exception_setup(true)) {
+        for (long r = 0; ok && r < reps; r++) {
+            if (need_rand)
+                fill_rand_string(randstr_buf, sizeof(randstr_buf));
+            if (q_insert_sorted(q, inserts, cmp)) {
+                qcnt++;
+            } else {
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Insertion of %s failed", inserts);
+                else {
+                    report(1,
+                           "ERROR: Insertion of %s failed (%d failures total)",
+                           inserts, fail_count);
+                    ok = false;
+                }
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+
+    ok = ok && check_sorted(cmp);
     show_queue(3);
     return ok;
 }
 
+static bool do_lower_bound(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling lower bound on null queue");
+    error_check();
+
+    const char *found = NULL;
+    if (exception_setup(true))
+        found = q_lower_bound(q, argv[1], cmp_get_func(cmp_func_idx));
+    exception_cancel();
+
+    bool ok = true;
+    if (found)
+        report(2, "Lower bound of %s is %s", argv[1], found);
+    else
+        report(2, "Lower bound of %s is past the tail", argv[1]);
+    if (argc == 3 && (!found || strcmp(found, argv[2]))) {
+        report(1, "ERROR: Lower bound %s != expected value %s",
+               (found) ? found : "(none)", argv[2]);
+        ok = false;
+    }
+
+    return ok && !error_check();
+}
+
 static bool do_remove_head(int argc, char *argv[])
 {
     if (argc != 1 && argc != 2) {
@@ -374,9 +1120,11 @@ static bool do_remove_head(int argc, char *argv[])
     error_check();
 
     bool rval = false;
+    set_bounded_mode(true);
     if (exception_setup(true))
         rval = q_remove_head(q, removes, string_length + 1);
     exception_cancel();
+    set_bounded_mode(false);
 
     if (rval) {
         removes[string_length + STRINGPAD] = '\0';
@@ -427,220 +1175,2117 @@ static bool do_remove_head(int argc, char *argv[])
 
 static bool do_remove_head_quiet(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    long reps = 1;
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
         return false;
     }
 
-    bool ok = true;
-    if (!q)
+    if (argc == 2) {
+        if (!get_long(argv[1], &reps)) {
+            report(1, "Invalid number of removals '%s'", argv[1]);
+            return false;
+        }
+    }
+
+    bool ok = true;
+    if (!q)
+        report(3, "Warning: Calling remove head on null queue");
+    else if (!q->head)
+        report(3, "Warning: Calling remove head on empty queue");
+    error_check();
+
+    size_t removed = 0;
+    if (reps > big_queue_size)
+        set_cautious_mode(false);
+    set_bounded_mode(true);
+    if (exception_setup(true)) {
+        for (long r = 0; ok && r < reps; r++) {
+            if (q_remove_head(q, NULL, 0)) {
+                removed++;
+                qcnt--;
+            } else {
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Removal failed");
+                else {
+                    report(1, "ERROR: Removal failed (%d failures total)",
+                           fail_count);
+                    ok = false;
+                }
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+    set_bounded_mode(false);
+    set_cautious_mode(true);
+
+    if (removed)
+        report(2, "Removed %lu element(s) from queue", removed);
+
+    show_queue(3);
+    return ok && !error_check();
+}
+
+/*
+ * Decode the pairs of hexadecimal digits of `hex`, or no bytes if it is "-",
+ * into a new buffer, and set *lenp to the number of bytes.
+ * Return NULL if `hex` is not made of such pairs or could not allocate
+ * space.
+ */
+static char *hex_decode(const char *hex, size_t *lenp)
+{
+    const size_t digits = strcmp(hex, "-") ? strlen(hex) : 0;
+    char *const buf = malloc(digits / 2 + 1);
+
+    if (!buf || digits % 2) {
+        report(1, "Invalid hexadecimal bytes '%s'", hex);
+        free(buf);
+        return NULL;
+    }
+    for (size_t i = 0; i < digits / 2; ++i) {
+        unsigned int byte;
+        if (!isxdigit((unsigned char) hex[2 * i]) ||
+            !isxdigit((unsigned char) hex[2 * i + 1]) ||
+            sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            report(1, "Invalid hexadecimal bytes '%s'", hex);
+            free(buf);
+            return NULL;
+        }
+        buf[i] = (char) byte;
+    }
+    *lenp = digits / 2;
+    return buf;
+}
+
+/*
+ * Report `what` followed by the first bytes of `p`, of `len` in all, in
+ * hexadecimal
+ */
+static void hex_report(int level, const char *what, const char *p, size_t len)
+{
+    const size_t shown = MIN(len, (size_t) string_length);
+    char *const hex = malloc(2 * shown + 4);
+
+    if (!hex)
+        return;
+    for (size_t i = 0; i < shown; ++i)
+        sprintf(hex + 2 * i, "%02x", (unsigned char) p[i]);
+    strcpy(hex + 2 * shown, (shown < len) ? "..." : "");
+    report(level, "%s %s (%lu bytes)", what, (len) ? hex : "-", len);
+    free(hex);
+}
+
+/* Insert bytes given in hexadecimal at the head or tail of queue */
+static bool insert_bytes(int argc, char *argv[], bool tail)
+{
+    long reps = 1;
+    size_t len;
+    bool ok = true;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+    if (argc == 3 && !get_long(argv[2], &reps)) {
+        report(1, "Invalid number of insertions '%s'", argv[2]);
+        return false;
+    }
+
+    char *const inserts = hex_decode(argv[1], &len);
+    if (!inserts)
+        return false;
+
+    if (!q)
+        report(3, "Warning: Calling insert %s on null queue",
+               (tail) ? "tail" : "head");
+    error_check();
+
+    set_bounded_mode(true);
+    if (exception_setup(true)) {
+        for (long r = 0; ok && r < reps; r++) {
+            bool rval = (tail) ? q_insert_tail_bytes(q, inserts, len)
+                               : q_insert_head_bytes(q, inserts, len);
+            if (rval) {
+                qcnt++;
+            } else {
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Insertion of %s failed", argv[1]);
+                else {
+                    report(1,
+                           "ERROR: Insertion of %s failed (%d failures total)",
+                           argv[1], fail_count);
+                    ok = false;
+                }
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+    set_bounded_mode(false);
+
+    free(inserts);
+    show_queue(3);
+    return ok;
+}
+
+static bool do_insert_head_bytes(int argc, char *argv[])
+{
+    return insert_bytes(argc, argv, false);
+}
+
+static bool do_insert_tail_bytes(int argc, char *argv[])
+{
+    return insert_bytes(argc, argv, true);
+}
+
+/*
+ * Compare the value `p` of `len` bytes, of which the first `shown` are
+ * available, to the expected ones in hexadecimal.
+ * Return false if they differ.
+ */
+static bool check_bytes(const char *what,
+                        const char *p,
+                        size_t len,
+                        size_t shown,
+                        const char *hex)
+{
+    size_t explen;
+    char *const expected = hex_decode(hex, &explen);
+    bool ok = expected && explen == len && !memcmp(p, expected, shown);
+
+    if (expected && !ok) {
+        report(1, "ERROR: %s value differs from expected value %s", what, hex);
+        hex_report(1, "Found", p, shown);
+    }
+    free(expected);
+    return ok;
+}
+
+static bool do_remove_head_bytes(int argc, char *argv[])
+{
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    char *removes = malloc(string_length + STRINGPAD);
+    if (!removes) {
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for removed values");
+        return false;
+    }
+    memset(removes, 'X', string_length + STRINGPAD);
+
+    if (!q)
         report(3, "Warning: Calling remove head on null queue");
     else if (!q->head)
         report(3, "Warning: Calling remove head on empty queue");
     error_check();
 
-    bool rval = false;
+    bool ok = true, rval = false;
+    size_t len = 0;
+    set_bounded_mode(true);
+    if (exception_setup(true))
+        rval = q_remove_head_bytes(q, removes, string_length, &len);
+    exception_cancel();
+    set_bounded_mode(false);
+
+    const size_t copied = MIN(len, (size_t) string_length);
+    if (rval) {
+        /* The bytes past those copied must keep their initial value 'X' */
+        size_t i = copied;
+        while (i < string_length + STRINGPAD && removes[i] == 'X')
+            i++;
+        if (i != string_length + STRINGPAD) {
+            report(1,
+                   "ERROR: copying of value in remove_head overflowed "
+                   "destination buffer.");
+            ok = false;
+        } else {
+            hex_report(2, "Removed", removes, len);
+        }
+        qcnt--;
+    } else {
+        fail_count++;
+        if (argc == 1 && fail_count < fail_limit) {
+            report(2, "Removal from queue failed");
+        } else {
+            report(1, "ERROR: Removal from queue failed (%d failures total)",
+                   fail_count);
+            ok = false;
+        }
+    }
+
+    if (ok && argc == 2)
+        ok = check_bytes("Removed", removes, len, copied, argv[1]);
+
+    show_queue(3);
+    free(removes);
+    return ok && !error_check();
+}
+
+static bool do_peek(int argc, char *argv[])
+{
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling peek on null queue");
+    error_check();
+
+    const void *p = NULL;
+    size_t len = 0;
+    if (exception_setup(true))
+        p = q_peek_head_bytes(q, &len);
+    exception_cancel();
+
+    bool ok = true;
+    if (!p) {
+        report(2, "Queue is empty");
+        if (argc == 2) {
+            report(1, "ERROR: Expected value %s at head", argv[1]);
+            ok = false;
+        }
+    } else {
+        hex_report(2, "Head is", p, len);
+        if (((const char *) p)[len] != '\0') {
+            report(1, "ERROR: Head value is not followed by a zero byte");
+            ok = false;
+        }
+        if (ok && argc == 2)
+            ok = check_bytes("Head", p, len, len, argv[1]);
+    }
+    return ok && !error_check();
+}
+
+static bool do_reverse(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling reverse on null queue");
+    error_check();
+
+    bool ok = unspill(q);
+    set_noallocate_mode(true);
+    if (ok && exception_setup(true))
+        q_reverse(q);
+    exception_cancel();
+
+    set_noallocate_mode(false);
+    show_queue(3);
+    return ok && !error_check();
+}
+
+static bool do_size(int argc, char *argv[])
+{
+    if (simulation) {
+        if (argc != 1) {
+            report(1, "%s does not need arguments in simulation mode", argv[0]);
+            return false;
+        }
+        bool ok = is_size_const();
+        if (!ok) {
+            report(1, "ERROR: Probably not constant time");
+            return false;
+        }
+        report(1, "Probably constant time");
+        return ok;
+    }
+
+    if (argc != 1 && argc != 2) {
+        report(1, "%s takes 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    long reps = 1;
+    bool ok = true;
+    if (argc == 2) {
+        if (!get_long(argv[1], &reps) || reps < 0) {
+            report(1, "Invalid number of calls to size '%s'", argv[1]);
+            return false;
+        }
+    }
+
+    size_t cnt = 0;
+    int small = 0;
+    if (!q)
+        report(3, "Warning: Calling size on null queue");
+    error_check();
+
+    if (exception_setup(true)) {
+        for (long r = 0; ok && r < reps; r++) {
+            cnt = q_size64(q);
+            small = q_size(q);
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+
+    if (ok) {
+        if (qcnt == cnt) {
+            report(2, "Queue size = %lu", cnt);
+        } else {
+            report(1,
+                   "ERROR: Computed queue size as %lu, but correct value is "
+                   "%lu",
+                   cnt, qcnt);
+            ok = false;
+        }
+    }
+    if (ok && small != (int) MIN(qcnt, INT_MAX)) {
+        report(1, "ERROR: Computed queue size as %d by q_size", small);
+        ok = false;
+    }
+
+    show_queue(3);
+
+    return ok && !error_check();
+}
+
+/*
+ * Check that the queue is in ascending order according to cmp.
+ * Return false with an error reported if it is not.
+ */
+static bool check_sorted(cmp_func_t cmp)
+{
+    bool ok = true;
+    if (!q)
+        return true;
+
+    size_t cnt = qcnt;
+    const char *batch[ITER_BATCH];
+    const char *prev = NULL;
+    q_iter_t it;
+    q_iter_init(&it, q);
+    while (ok && cnt > 0) {
+        size_t n = q_iter_next_batch(&it, batch, MIN(cnt, ITER_BATCH));
+        if (!n)
+            break;
+        for (size_t i = 0; i < n; i++) {
+            /* Ensure each element in ascending order */
+            if (prev && cmp(prev, batch[i]) > 0) {
+                report(1, "ERROR: Not sorted in ascending order");
+                ok = false;
+                break;
+            }
+            prev = batch[i];
+        }
+        cnt -= n;
+    }
+    return ok;
+}
+
+static bool do_dedup(int argc, char *argv[])
+{
+    if (argc != 1 && (argc != 2 || strcmp(argv[1], "hash"))) {
+        report(1, "%s takes no arguments other than hash", argv[0]);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling dedup on null queue");
+    error_check();
+
+    const cmp_func_t cmp = (argc == 1) ? cmp_get_func(cmp_func_idx) : NULL;
+    bool ok = false;
+    double time = 0;
+    init_time(&time);
+    if (qcnt > big_queue_size)
+        set_cautious_mode(false);
+    if (exception_setup(true))
+        ok = q_delete_dup(q, cmp);
+    exception_cancel();
+    set_cautious_mode(true);
+    time = delta_time(&time);
+
+    if (ok) {
+        const size_t cnt = q_size(q);
+        report(1, "Removed %lu duplicate(s) in %.3f seconds", qcnt - cnt,
+               time);
+        qcnt = cnt;
+    } else if (q) {
+        report(1, "ERROR: Could not delete duplicates");
+    }
+
+    /* Each kept element is strictly greater than the one before */
+    if (ok && cmp) {
+        const char *batch[ITER_BATCH];
+        const char *prev = NULL;
+        size_t cnt = 0, n;
+        q_iter_t it;
+        q_iter_init(&it, q);
+        while (ok && cnt < qcnt &&
+               (n = q_iter_next_batch(&it, batch,
+                                      MIN(qcnt - cnt, ITER_BATCH)))) {
+            for (size_t i = 0; ok && i < n; i++) {
+                if (prev && cmp(prev, batch[i]) >= 0) {
+                    report(1, "ERROR: Duplicates left in queue");
+                    ok = false;
+                }
+                prev = batch[i];
+            }
+            cnt += n;
+        }
+    }
+
+    ok = show_queue(3) && ok;
+    return ok && !error_check();
+}
+
+static int cmp_str_ptr(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *) a, *(const char *const *) b);
+}
+
+/* Check that no string appears in two separate runs of elements */
+static bool check_grouped()
+{
+    if (!q || qcnt < 2)
+        return true;
+
+    const char **runs = malloc(qcnt * sizeof(char *));
+    if (!runs) {
+        report(1, "INTERNAL ERROR.  Could not allocate space for check");
+        return false;
+    }
+
+    /* Collect the first value of each run */
+    const char *batch[ITER_BATCH];
+    size_t cnt = 0, nruns = 0, n;
+    q_iter_t it;
+    q_iter_init(&it, q);
+    while (cnt < qcnt &&
+           (n = q_iter_next_batch(&it, batch, MIN(qcnt - cnt, ITER_BATCH)))) {
+        for (size_t i = 0; i < n; i++) {
+            if (!nruns || strcmp(runs[nruns - 1], batch[i]))
+                runs[nruns++] = batch[i];
+        }
+        cnt += n;
+    }
+
+    bool ok = true;
+    qsort(runs, nruns, sizeof(char *), cmp_str_ptr);
+    for (size_t i = 1; ok && i < nruns; i++) {
+        if (!strcmp(runs[i - 1], runs[i])) {
+            report(1, "ERROR: %s is not grouped", runs[i]);
+            ok = false;
+        }
+    }
+    free(runs);
+    return ok;
+}
+
+/*
+ * Return the KiB of memory of the process in transparent huge pages, or -1
+ * if the kernel does not tell
+ */
+static long anon_huge_kib()
+{
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    char line[128];
+    long kib = -1;
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kib) == 1)
+            break;
+    }
+    fclose(f);
+    return kib;
+}
+
+static bool do_mem(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    report(1,
+           "Allocated %lu bytes, peak %lu bytes; peak resident set %ld KiB",
+           allocation_bytes(), allocation_peak_bytes(true), usage.ru_maxrss);
+    if (q_spilled(q))
+        report(1, "Spilled %lu element(s) of queue to a file", q_spilled(q));
+    if (aq_size(aq))
+        report(1, "Arena queue of %lu element(s) takes %lu bytes, %.1f each",
+               aq_size(aq), aq_bytes(aq),
+               (double) aq_bytes(aq) / aq_size(aq));
+    alloc_stats_t astats;
+    if (q && alloc_tracked_stats(q->alloc, &astats))
+        report(1,
+               "Elements take %lu block(s) of %lu bytes, peak %lu bytes, from "
+               "%s allocator",
+               astats.blocks, astats.bytes, astats.peak_bytes, q->alloc->name);
+    if (reclaim_finished() || reclaim_pending())
+        report(1, "Freed %lu queue(s) in the background, %lu pending",
+               reclaim_finished(), reclaim_pending());
+    q_huge_stats_t huge;
+    q_huge_stats(q, &huge);
+    if (huge.regions)
+        report(1,
+               "Mapped %lu region(s) of 2 MiB for elements; %lu of reserved "
+               "huge pages, %lu advised to use transparent ones; %ld KiB in "
+               "transparent huge pages",
+               huge.regions, huge.hugetlb, huge.advised, anon_huge_kib());
+    q_seg_stats_t stats;
+    q_segment_stats(q, &stats);
+    if (stats.k)
+        report(1,
+               "Segment index of %lu entries every %lu elements takes %lu "
+               "bytes; %lu updates, %lu rebuilds",
+               stats.entries, stats.k, stats.bytes, stats.updates,
+               stats.rebuilds);
+    return true;
+}
+
+static bool do_group(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling group on null queue");
+    error_check();
+
+    /* Grouping must not allocate once its bucket table is reserved */
+    bool ok = unspill(q);
+    if (ok && q && !q_reserve_scratch(q, qcnt)) {
+        report(1, "ERROR: Could not reserve scratch space for %lu elements",
+               qcnt);
+        ok = false;
+    }
+
+    set_noallocate_mode(true);
+    if (ok && exception_setup(true))
+        ok = q_group(q) || !q;
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    ok = ok && check_grouped();
+    ok = show_queue(3) && ok;
+    return ok && !error_check();
+}
+
+static bool do_contains(int argc, char *argv[])
+{
+    char randstr_buf[MAX_RANDSTR_LEN];
+    long reps = 1, found = 0;
+    bool need_rand = false;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    char *lookups = argv[1];
+    if (argc == 3) {
+        if (!get_long(argv[2], &reps)) {
+            report(1, "Invalid number of lookups '%s'", argv[2]);
+            return false;
+        }
+    }
+
+    if (!strcmp(lookups, "RAND")) {
+        need_rand = true;
+        lookups = randstr_buf;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling contains on null queue");
+    error_check();
+
+    set_noallocate_mode(true);
+    if (exception_setup(true)) {
+        for (long r = 0; r < reps; r++) {
+            if (need_rand)
+                fill_rand_string(randstr_buf, sizeof(randstr_buf));
+            if (q_contains(q, lookups))
+                found++;
+        }
+    }
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    if (reps == 1)
+        report(2, "Queue %s %s", found ? "contains" : "does not contain",
+               lookups);
+    else
+        report(2, "Found %ld of %ld string(s)", found, reps);
+    return !error_check();
+}
+
+static bool do_count(int argc, char *argv[])
+{
+    long expected = 0;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    bool check = argc == 3;
+    if (check && (!get_long(argv[2], &expected) || expected < 0)) {
+        report(1, "Invalid number of elements '%s'", argv[2]);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling count on null queue");
+    error_check();
+
+    size_t cnt = 0;
+    bool contains = false;
+    set_noallocate_mode(true);
+    if (exception_setup(true)) {
+        cnt = q_count(q, argv[1]);
+        contains = q_contains(q, argv[1]);
+    }
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    bool ok = true;
+    report(2, "Queue holds %s %lu time(s)", argv[1], cnt);
+    if (contains != (cnt > 0)) {
+        report(1, "ERROR: Contains and count of %s disagree", argv[1]);
+        ok = false;
+    }
+    if (check && cnt != (size_t) expected) {
+        report(1, "ERROR: Counted %lu elements holding %s, but %ld expected",
+               cnt, argv[1], expected);
+        ok = false;
+    }
+    return ok && !error_check();
+}
+
+static bool do_at(int argc, char *argv[])
+{
+    long pos = 0;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+    if (!get_long(argv[1], &pos) || pos < 0) {
+        report(1, "Invalid position '%s'", argv[1]);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling at on null queue");
+    error_check();
+
+    const char *found = NULL;
+    set_bounded_mode(true);
+    if (exception_setup(true))
+        found = q_value_at(q, pos);
+    exception_cancel();
+    set_bounded_mode(false);
+
+    bool ok = true;
+    if (found) {
+        report(2, "Value at %ld is %s", pos, found);
+    } else if (q && (size_t) pos < qcnt) {
+        report(1, "ERROR: Could not find value at %ld", pos);
+        ok = false;
+    } else {
+        report(2, "Position %ld is past the tail", pos);
+    }
+    if (argc == 3 && (!found || strcmp(found, argv[2]))) {
+        report(1, "ERROR: Value at %ld %s != expected value %s", pos,
+               (found) ? found : "(none)", argv[2]);
+        ok = false;
+    }
+
+    return ok && !error_check();
+}
+
+static bool do_split(int argc, char *argv[])
+{
+    long pos = 0;
+    int dst = 0;
+    if (argc != 3) {
+        report(1, "%s needs 2 arguments", argv[0]);
+        return false;
+    }
+    if (!get_long(argv[1], &pos) || pos < 0) {
+        report(1, "Invalid position '%s'", argv[1]);
+        return false;
+    }
+    if (!get_int(argv[2], &dst) || dst < 0 || dst >= MAX_QUEUES ||
+        dst == queue_idx) {
+        report(1, "Invalid queue number '%s'", argv[2]);
+        return false;
+    }
+    if (qcnts[dst]) {
+        report(1, "Queue %d is not empty", dst);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling split on null queue");
+    error_check();
+
+    queue_join(queue_idx, dst);
+    bool ok = false;
+    if (exception_setup(true)) {
+        if (q && !queues[dst]) {
+            queues[dst] = q_new();
+            if (queues[dst] && segments)
+                q_set_segments(queues[dst], segments);
+        }
+        ok = q_split(q, pos, queues[dst]);
+    }
+    exception_cancel();
+
+    if (ok && (size_t) pos < qcnt) {
+        qcnts[dst] = qcnt - pos;
+        qcnt = pos;
+    } else if (!ok && q && (size_t) pos > qcnt) {
+        report(2, "Position %ld is past the tail", pos);
+        ok = true;
+    } else if (!ok && q) {
+        report(1, "ERROR: Could not split queue");
+    }
+
+    show_queue(3);
+    return ok && !error_check();
+}
+
+static bool do_compact(int argc, char *argv[])
+{
+    long slice = 0;
+    if (argc != 1 && argc != 2) {
+        report(1, "%s takes 0-1 arguments", argv[0]);
+        return false;
+    }
+    if (argc == 2 && (!get_long(argv[1], &slice) || slice <= 0)) {
+        report(1, "Invalid number of elements '%s'", argv[1]);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling compact on null queue");
+    error_check();
+
+    const size_t max = (slice) ? (size_t) slice : SIZE_MAX;
+    size_t moved = 0, slices = 0, n = max;
+    if (qcnt > big_queue_size)
+        set_cautious_mode(false);
+    if (exception_setup(true)) {
+        while (n == max && !error_check()) {
+            n = q_compact(q, max);
+            moved += n;
+            ++slices;
+        }
+    }
+    exception_cancel();
+    set_cautious_mode(true);
+
+    report(2, "Moved %lu element(s) in %lu slice(s)", moved, slices);
+    show_queue(3);
+    return !error_check();
+}
+
+static bool do_merge(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!q)
+        report(3, "Warning: Calling merge on null queue");
+    error_check();
+
+    queue_t *srcs[MAX_QUEUES];
+    size_t k = 0, cnt = qcnt;
+    for (int i = 0; i < MAX_QUEUES; i++) {
+        if (queues[i]) {
+            srcs[k++] = queues[i];
+            cnt += qcnts[i];
+            queue_join(queue_idx, i);
+        }
+    }
+
+    const cmp_func_t cmp = cmp_get_func(cmp_func_idx);
+    bool ok = unspill(q);
+    for (size_t i = 0; i < k; i++)
+        ok = ok && unspill(srcs[i]);
+    set_noallocate_mode(true);
+    if (ok && exception_setup(true))
+        ok = q_merge_sorted(q, srcs, k, cmp);
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    if (ok) {
+        qcnt = cnt;
+        for (int i = 0; i < MAX_QUEUES; i++)
+            qcnts[i] = 0;
+        ok = check_sorted(cmp);
+    } else if (q) {
+        report(1, "ERROR: Could not merge queues");
+    }
+
+    show_queue(3);
+    return ok && !error_check();
+}
+
+/*
+ * Check that the first `k` elements are in ascending order and that none of
+ * the others is less than them
+ */
+static bool check_topk(cmp_func_t cmp, size_t k)
+{
+    if (!q || !k)
+        return true;
+
+    const char *batch[ITER_BATCH];
+    const char *prev = NULL;
+    size_t cnt = 0;
+    q_iter_t it;
+    q_iter_init(&it, q);
+    while (cnt < qcnt) {
+        size_t n = q_iter_next_batch(&it, batch, MIN(qcnt - cnt, ITER_BATCH));
+        if (!n)
+            break;
+        for (size_t i = 0; i < n; i++, cnt++) {
+            if (prev && cmp(prev, batch[i]) > 0) {
+                report(1, "ERROR: %s smallest elements not moved to head",
+                       (cnt < k) ? "Not sorted the" : "Not found the");
+                return false;
+            }
+            /* The k-th element bounds all the following ones */
+            if (cnt < k)
+                prev = batch[i];
+        }
+    }
+    return true;
+}
+
+static bool do_sort(int argc, char *argv[])
+{
+    long k = 0;
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    if (argc == 2) {
+        if (!get_long(argv[1], &k) || k < 0) {
+            report(1, "Invalid number of elements '%s'", argv[1]);
+            return false;
+        }
+    }
+
+    if (!q)
+        report(3, "Warning: Calling sort on null queue");
+    error_check();
+
+    size_t cnt = q_size64(q);
+    if (cnt < 2)
+        report(3, "Warning: Calling sort on single node");
+    error_check();
+
+    /* A spilled queue is sorted in its file under a sort budget */
+    const bool on_disk = argc == 1 && q && q->sort_budget && q_spilled(q);
+
+    /* Partial sort must not allocate once its scratch space is reserved */
+    bool ok = on_disk || unspill(q);
+    if (ok && argc == 2 && q &&
+        !q_reserve_sort_scratch(q, MIN((size_t) k, cnt))) {
+        report(1, "ERROR: Could not reserve scratch space for %ld elements",
+               k);
+        ok = false;
+    }
+
+    /* Sorting by key prefixes needs scratch space, or merges lists instead */
+    if (ok && argc == 1 && q && !on_disk)
+        q_reserve_sort_scratch(q, cnt);
+
+    /* External sort allocates its buffers, but no more than the budget */
+    const cmp_func_t cmp = cmp_get_func(cmp_func_idx);
+    const size_t before = allocation_bytes();
+    allocation_peak_bytes(true);
+    set_noallocate_mode(argc == 2 || !q || !q->sort_budget);
+    /* Sorting in the file frees the elements of the lists */
+    if (on_disk && qcnt > big_queue_size)
+        set_cautious_mode(false);
+    if (ok && exception_setup(true)) {
+        if (argc == 2)
+            ok = q_sort_topk(q, k, cmp) || !q;
+        else
+            q_sort(q, cmp);
+    }
+    exception_cancel();
+    set_cautious_mode(true);
+    set_noallocate_mode(false);
+
+    const size_t peak = allocation_peak_bytes(false);
+    if (ok && on_disk && peak > before + q->sort_budget) {
+        report(1, "ERROR: Sorting took %lu bytes, beyond the budget of %lu",
+               peak - before, q->sort_budget);
+        ok = false;
+    }
+
+    if (argc == 2)
+        ok = ok && check_topk(cmp, k);
+    else
+        ok = check_sorted(cmp);
+
+    show_queue(3);
+    return ok && !error_check();
+}
+
+static bool show_queue(int vlevel)
+{
+    bool ok = true;
+    if (verblevel < vlevel)
+        return true;
+
+    size_t cnt = 0;
+    if (!q) {
+        report(vlevel, "q = NULL");
+        return true;
+    }
+
+    report_noreturn(vlevel, "q = [");
+    const char *batch[ITER_BATCH];
+    bool more = false;
+    q_iter_t it;
+    q_iter_init(&it, q);
+    if (exception_setup(true)) {
+        while (ok && cnt < qcnt) {
+            size_t n =
+                q_iter_next_batch(&it, batch, MIN(qcnt - cnt, ITER_BATCH));
+            if (!n)
+                break;
+            for (size_t i = 0; i < n && cnt + i < big_queue_size; i++)
+                report_noreturn(vlevel, cnt + i == 0 ? "%s" : " %s", batch[i]);
+            cnt += n;
+            ok = ok && !error_check();
+        }
+        /* Anything beyond `qcnt` elements indicates a cycle */
+        more = ok && q_iter_next_batch(&it, batch, 1);
+    }
+    exception_cancel();
+
+    if (!ok) {
+        report(vlevel, " ... ]");
+        return false;
+    }
+
+    if (!more) {
+        if (cnt <= big_queue_size)
+            report(vlevel, "]");
+        else
+            report(vlevel, " ... ]");
+    } else {
+        report(vlevel, " ... ]");
+        report(vlevel,
+               "ERROR:  Either list has cycle, or queue has more than %lu "
+               "elements",
+               qcnt);
+        ok = false;
+    }
+
+    return ok;
+}
+
+static bool do_show(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+    return show_queue(0);
+}
+
+static bool do_pq_new(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    bool ok = true;
+    if (pq) {
+        report(3, "Freeing old priority queue");
+        ok = do_pq_free(argc, argv);
+    }
+    error_check();
+
+    if (exception_setup(true))
+        pq = pq_new(cmp_get_func(cmp_func_idx));
+    exception_cancel();
+    pqcnt = 0;
+    show_pqueue(3);
+
+    return ok && !error_check();
+}
+
+static bool do_pq_free(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!pq)
+        report(3, "Warning: Calling free on null priority queue");
+    error_check();
+
+    if (pqcnt > big_queue_size)
+        set_cautious_mode(false);
+    if (exception_setup(true))
+        pq_free(pq);
+    exception_cancel();
+    set_cautious_mode(true);
+
+    pq = NULL;
+    pqcnt = 0;
+    show_pqueue(3);
+
+    bool ok = leak_check();
+    return ok && !error_check();
+}
+
+static bool do_pq_insert(int argc, char *argv[])
+{
+    char randstr_buf[MAX_RANDSTR_LEN];
+    int reps = 1;
+    bool ok = true, need_rand = false;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    char *inserts = argv[1];
+    if (argc == 3) {
+        if (!get_int(argv[2], &reps)) {
+            report(1, "Invalid number of insertions '%s'", argv[2]);
+            return false;
+        }
+    }
+
+    if (!strcmp(inserts, "RAND")) {
+        need_rand = true;
+        inserts = randstr_buf;
+    }
+
+    if (!pq)
+        report(3, "Warning: Calling insert on null priority queue");
+    error_check();
+
+    if (exception_setup(true)) {
+        for (int r = 0; ok && r < reps; r++) {
+            if (need_rand)
+                fill_rand_string(randstr_buf, sizeof(randstr_buf));
+            if (pq_insert(pq, inserts)) {
+                pqcnt++;
+            } else {
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Insertion of %s failed", inserts);
+                else {
+                    report(1,
+                           "ERROR: Insertion of %s failed (%d failures total)",
+                           inserts, fail_count);
+                    ok = false;
+                }
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+
+    show_pqueue(3);
+    return ok;
+}
+
+static bool do_pq_remove(int argc, char *argv[])
+{
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    char *removes = malloc(string_length + 1);
+    if (!removes) {
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for removed strings");
+        return false;
+    }
+
+    bool check = argc > 1;
+    bool ok = true;
+    removes[0] = '\0';
+
+    if (!pq)
+        report(3, "Warning: Calling remove minimum on null priority queue");
+    else if (!pq->root)
+        report(3, "Warning: Calling remove minimum on empty priority queue");
+    error_check();
+
+    /* The value must not be larger than any one left in priority queue */
+    const char *next = NULL;
+    bool rval = false;
+    if (exception_setup(true)) {
+        rval = pq_remove_min(pq, removes, string_length + 1);
+        next = pq_peek_min(pq);
+    }
+    exception_cancel();
+
+    if (rval) {
+        report(2, "Removed %s from priority queue", removes);
+        pqcnt--;
+        if (next && pq->cmp(removes, next) > 0) {
+            report(1, "ERROR: Removed value %s is larger than %s", removes,
+                   next);
+            ok = false;
+        }
+    } else {
+        fail_count++;
+        if (!check && fail_count < fail_limit) {
+            report(2, "Removal from priority queue failed");
+        } else {
+            report(1,
+                   "ERROR: Removal from priority queue failed (%d failures "
+                   "total)",
+                   fail_count);
+            ok = false;
+        }
+    }
+
+    if (ok && check && strncmp(removes, argv[1], string_length)) {
+        report(1, "ERROR: Removed value %s != expected value %s", removes,
+               argv[1]);
+        ok = false;
+    }
+
+    show_pqueue(3);
+
+    free(removes);
+    return ok && !error_check();
+}
+
+static bool do_pq_remove_quiet(int argc, char *argv[])
+{
+    int reps = 1;
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    if (argc == 2) {
+        if (!get_int(argv[1], &reps)) {
+            report(1, "Invalid number of removals '%s'", argv[1]);
+            return false;
+        }
+    }
+
+    bool ok = true;
+    if (!pq)
+        report(3, "Warning: Calling remove minimum on null priority queue");
+    else if (!pq->root)
+        report(3, "Warning: Calling remove minimum on empty priority queue");
+    error_check();
+
+    int removed = 0;
+    if (reps > big_queue_size)
+        set_cautious_mode(false);
+    if (exception_setup(true)) {
+        for (int r = 0; ok && r < reps; r++) {
+            if (pq_remove_min(pq, NULL, 0)) {
+                removed++;
+                pqcnt--;
+            } else {
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Removal failed");
+                else {
+                    report(1, "ERROR: Removal failed (%d failures total)",
+                           fail_count);
+                    ok = false;
+                }
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+    set_cautious_mode(true);
+
+    if (removed)
+        report(2, "Removed %d element(s) from priority queue", removed);
+
+    show_pqueue(3);
+    return ok && !error_check();
+}
+
+static bool show_pqueue(int vlevel)
+{
+    if (verblevel < vlevel)
+        return true;
+
+    if (!pq) {
+        report(vlevel, "pq = NULL");
+        return true;
+    }
+
+    bool ok = true;
+    size_t cnt = 0;
+    const char *min = NULL;
+    if (exception_setup(true)) {
+        cnt = pq_size(pq);
+        min = pq_peek_min(pq);
+    }
+    exception_cancel();
+
+    if (cnt != pqcnt) {
+        report(1, "ERROR: Priority queue has %lu elements, but expected %lu",
+               cnt, pqcnt);
+        ok = false;
+    }
+    if (min)
+        report(vlevel, "pq = [%s ... ] (%lu elements)", min, cnt);
+    else
+        report(vlevel, "pq = []");
+    return ok;
+}
+
+static bool do_lru_new(int argc, char *argv[])
+{
+    int capacity = 0;
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    if (argc == 2) {
+        if (!get_int(argv[1], &capacity) || capacity < 0) {
+            report(1, "Invalid capacity '%s'", argv[1]);
+            return false;
+        }
+    }
+
+    bool ok = true;
+    if (lru) {
+        report(3, "Freeing old recency list");
+        ok = do_lru_free(1, argv);
+    }
+    error_check();
+
+    if (exception_setup(true))
+        lru = lru_new(capacity);
+    exception_cancel();
+    show_lru(3);
+
+    return ok && !error_check();
+}
+
+static bool do_lru_free(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!lru)
+        report(3, "Warning: Calling free on null recency list");
+    error_check();
+
+    if (lru_size(lru) > big_queue_size)
+        set_cautious_mode(false);
+    if (exception_setup(true))
+        lru_free(lru);
+    exception_cancel();
+    set_cautious_mode(true);
+
+    lru = NULL;
+    show_lru(3);
+
+    bool ok = leak_check();
+    return ok && !error_check();
+}
+
+static bool do_lru_touch(int argc, char *argv[])
+{
+    char randstr_buf[MAX_RANDSTR_LEN];
+    int reps = 1;
+    bool ok = true, need_rand = false;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    char *touches = argv[1];
+    if (argc == 3) {
+        if (!get_int(argv[2], &reps)) {
+            report(1, "Invalid number of touches '%s'", argv[2]);
+            return false;
+        }
+    }
+
+    if (!strcmp(touches, "RAND")) {
+        need_rand = true;
+        touches = randstr_buf;
+    }
+
+    if (!lru)
+        report(3, "Warning: Calling touch on null recency list");
+    error_check();
+
+    if (reps > big_queue_size)
+        set_cautious_mode(false);
+    if (exception_setup(true)) {
+        for (int r = 0; ok && r < reps; r++) {
+            if (need_rand)
+                fill_rand_string(randstr_buf, sizeof(randstr_buf));
+            lru_status_t status = lru_touch(lru, touches);
+            if (status == LRU_FAIL) {
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Touch of %s failed", touches);
+                else {
+                    report(1, "ERROR: Touch of %s failed (%d failures total)",
+                           touches, fail_count);
+                    ok = false;
+                }
+            } else if (reps == 1) {
+                report(2, "Touch of %s %s", touches,
+                       (status == LRU_HIT) ? "hit" : "missed");
+            } else if (lru->head->value == touches) {
+                report(1, "ERROR: Need to allocate and copy string for new "
+                          "list element");
+                ok = false;
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+    set_cautious_mode(true);
+
+    ok = show_lru(3) && ok;
+    return ok;
+}
+
+static bool do_lru_evict(int argc, char *argv[])
+{
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    char *removes = malloc(string_length + 1);
+    if (!removes) {
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for removed strings");
+        return false;
+    }
+
+    bool check = argc > 1;
+    bool ok = true;
+    removes[0] = '\0';
+
+    if (!lru)
+        report(3, "Warning: Calling evict on null recency list");
+    else if (!lru->tail)
+        report(3, "Warning: Calling evict on empty recency list");
+    error_check();
+
+    bool rval = false;
+    if (exception_setup(true))
+        rval = lru_evict_tail(lru, removes, string_length + 1);
+    exception_cancel();
+
+    if (rval) {
+        report(2, "Evicted %s from recency list", removes);
+    } else {
+        fail_count++;
+        if (!check && fail_count < fail_limit) {
+            report(2, "Eviction from recency list failed");
+        } else {
+            report(1,
+                   "ERROR: Eviction from recency list failed (%d failures "
+                   "total)",
+                   fail_count);
+            ok = false;
+        }
+    }
+
+    if (ok && check && strncmp(removes, argv[1], string_length)) {
+        report(1, "ERROR: Evicted value %s != expected value %s", removes,
+               argv[1]);
+        ok = false;
+    }
+
+    ok = show_lru(3) && ok;
+
+    free(removes);
+    return ok && !error_check();
+}
+
+/*
+ * Return the index of the first entry of `cdf` which is not less than `u`.
+ * There are `n` entries in ascending order, and the last one is not less
+ * than `u`.
+ */
+static int zipf_search(const double *cdf, int n, double u)
+{
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static bool do_lru_zipf(int argc, char *argv[])
+{
+    int reps, keys;
+    bool ok = true;
+    if (argc != 3) {
+        report(1, "%s needs 2 arguments", argv[0]);
+        return false;
+    }
+
+    if (!get_int(argv[1], &reps) || reps < 0) {
+        report(1, "Invalid number of touches '%s'", argv[1]);
+        return false;
+    }
+    if (!get_int(argv[2], &keys) || keys <= 0) {
+        report(1, "Invalid number of keys '%s'", argv[2]);
+        return false;
+    }
+
+    if (!lru) {
+        report(1, "ERROR: Calling Zipf touches on null recency list");
+        return false;
+    }
+
+    /* The weight of the key of rank k is 1 / k */
+    double *cdf = malloc(keys * sizeof(double));
+    if (!cdf) {
+        report(1, "INTERNAL ERROR.  Could not allocate space for keys");
+        return false;
+    }
+    double sum = 0;
+    for (int k = 0; k < keys; k++) {
+        sum += 1.0 / (k + 1);
+        cdf[k] = sum;
+    }
+    for (int k = 0; k < keys; k++)
+        cdf[k] /= sum;
+    cdf[keys - 1] = 1.0;
+
+    size_t hits = lru->hits, misses = lru->misses;
+    char key[32];
+    set_cautious_mode(false);
+    if (exception_setup(true)) {
+        for (int r = 0; ok && r < reps; r++) {
+            double u = (double) rand() / RAND_MAX;
+            snprintf(key, sizeof(key), "key%d", zipf_search(cdf, keys, u));
+            if (lru_touch(lru, key) == LRU_FAIL) {
+                report(1, "ERROR: Touch of %s failed", key);
+                ok = false;
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+    set_cautious_mode(true);
+    free(cdf);
+
+    hits = lru->hits - hits;
+    misses = lru->misses - misses;
+    report(1, "Hits: %lu, misses: %lu, hit ratio: %.2f%%", hits, misses,
+           (hits + misses) ? 100.0 * hits / (hits + misses) : 0.0);
+
+    ok = show_lru(3) && ok;
+    return ok && !error_check();
+}
+
+static bool show_lru(int vlevel)
+{
+    bool ok = true;
+    if (verblevel < vlevel)
+        return true;
+
+    if (!lru) {
+        report(vlevel, "lru = NULL");
+        return true;
+    }
+
+    size_t cnt = 0;
+    report_noreturn(vlevel, "lru = [");
+    if (exception_setup(true)) {
+        const lru_ele_t *prev = NULL;
+        for (const lru_ele_t *e = lru->head; ok && e; e = e->next) {
+            if (cnt < big_queue_size)
+                report_noreturn(vlevel, cnt == 0 ? "%s" : " %s", e->value);
+            if (e->prev != prev || ++cnt > lru->size) {
+                report(vlevel, " ... ]");
+                report(1, "ERROR: Recency list is broken");
+                ok = false;
+            }
+            prev = e;
+        }
+        if (ok && prev != lru->tail) {
+            report(vlevel, " ... ]");
+            report(1, "ERROR: Recency list has a wrong tail");
+            ok = false;
+        }
+    }
+    exception_cancel();
+
+    if (ok)
+        report(vlevel, (cnt <= big_queue_size) ? "]" : " ... ]");
+    if (ok && lru->capacity && cnt > lru->capacity) {
+        report(1, "ERROR: Recency list holds %lu strings, more than %lu",
+               cnt, lru->capacity);
+        ok = false;
+    }
+    return ok;
+}
+
+/* Draw 64 random bits from rand(), which yields at least 31 bits */
+static uint64_t rand_u64()
+{
+    return ((uint64_t) rand() << 33) ^ ((uint64_t) rand() << 11) ^ rand();
+}
+
+/* Parse an unsigned 64-bit integer, or draw a random one for RAND */
+static bool get_u64(const char *vname, uint64_t *loc)
+{
+    if (!strcmp(vname, "RAND")) {
+        *loc = rand_u64();
+        return true;
+    }
+
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(vname, &end, 0);
+    if (errno || *vname == '\0' || *vname == '-' || *end != '\0')
+        return false;
+    *loc = v;
+    return true;
+}
+
+static bool do_u64_new(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    bool ok = true;
+    if (uq) {
+        report(3, "Freeing old integer queue");
+        ok = do_u64_free(argc, argv);
+    }
+    error_check();
+
+    if (exception_setup(true))
+        uq = u64q_new();
+    exception_cancel();
+    show_u64queue(3);
+
+    return ok && !error_check();
+}
+
+static bool do_u64_free(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!uq)
+        report(3, "Warning: Calling free on null integer queue");
+    error_check();
+
+    if (u64q_size(uq) > big_queue_size)
+        set_cautious_mode(false);
+    if (exception_setup(true))
+        u64q_free(uq);
+    exception_cancel();
+    set_cautious_mode(true);
+
+    uq = NULL;
+    show_u64queue(3);
+
+    bool ok = leak_check();
+    return ok && !error_check();
+}
+
+static bool do_u64_insert_tail(int argc, char *argv[])
+{
+    uint64_t v;
+    int reps = 1;
+    bool ok = true;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    bool need_rand = !strcmp(argv[1], "RAND");
+    if (!get_u64(argv[1], &v)) {
+        report(1, "Invalid integer '%s'", argv[1]);
+        return false;
+    }
+    if (argc == 3) {
+        if (!get_int(argv[2], &reps)) {
+            report(1, "Invalid number of insertions '%s'", argv[2]);
+            return false;
+        }
+    }
+
+    if (!uq)
+        report(3, "Warning: Calling insert tail on null integer queue");
+    error_check();
+
+    if (exception_setup(true)) {
+        for (int r = 0; ok && r < reps; r++) {
+            if (need_rand)
+                v = rand_u64();
+            if (!u64q_insert_tail(uq, v)) {
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Insertion of %lu failed", v);
+                else {
+                    report(1,
+                           "ERROR: Insertion of %lu failed (%d failures "
+                           "total)",
+                           v, fail_count);
+                    ok = false;
+                }
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+
+    ok = show_u64queue(3) && ok;
+    return ok;
+}
+
+static bool do_u64_remove(int argc, char *argv[])
+{
+    uint64_t expected = 0, v = 0;
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    bool check = argc > 1;
+    if (check && !get_u64(argv[1], &expected)) {
+        report(1, "Invalid integer '%s'", argv[1]);
+        return false;
+    }
+
+    if (!uq)
+        report(3, "Warning: Calling remove head on null integer queue");
+    else if (!uq->head)
+        report(3, "Warning: Calling remove head on empty integer queue");
+    error_check();
+
+    bool ok = true, rval = false;
     if (exception_setup(true))
-        rval = q_remove_head(q, NULL, 0);
+        rval = u64q_remove_head(uq, &v);
     exception_cancel();
 
     if (rval) {
-        report(2, "Removed element from queue");
-        qcnt--;
+        report(2, "Removed %lu from integer queue", v);
     } else {
         fail_count++;
-        if (fail_count < fail_limit)
-            report(2, "Removal failed");
-        else {
-            report(1, "ERROR: Removal failed (%d failures total)", fail_count);
+        if (!check && fail_count < fail_limit) {
+            report(2, "Removal from integer queue failed");
+        } else {
+            report(1,
+                   "ERROR: Removal from integer queue failed (%d failures "
+                   "total)",
+                   fail_count);
             ok = false;
         }
     }
 
-    show_queue(3);
+    if (ok && check && v != expected) {
+        report(1, "ERROR: Removed value %lu != expected value %lu", v,
+               expected);
+        ok = false;
+    }
+
+    ok = show_u64queue(3) && ok;
     return ok && !error_check();
 }
 
-static bool do_reverse(int argc, char *argv[])
+static bool do_u64_reverse(int argc, char *argv[])
 {
     if (argc != 1) {
         report(1, "%s takes no arguments", argv[0]);
         return false;
     }
 
-    if (!q)
-        report(3, "Warning: Calling reverse on null queue");
+    if (!uq)
+        report(3, "Warning: Calling reverse on null integer queue");
     error_check();
 
     set_noallocate_mode(true);
     if (exception_setup(true))
-        q_reverse(q);
+        u64q_reverse(uq);
     exception_cancel();
 
     set_noallocate_mode(false);
-    show_queue(3);
+    show_u64queue(3);
     return !error_check();
 }
 
-static bool do_size(int argc, char *argv[])
+static bool do_u64_sort(int argc, char *argv[])
 {
-    if (simulation) {
-        if (argc != 1) {
-            report(1, "%s does not need arguments in simulation mode", argv[0]);
-            return false;
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!uq)
+        report(3, "Warning: Calling sort on null integer queue");
+    error_check();
+
+    set_noallocate_mode(true);
+    if (exception_setup(true))
+        u64q_sort(uq);
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    bool ok = true;
+    if (uq) {
+        const u64q_ele_t *e = uq->head;
+        for (size_t i = 1; ok && e && i < uq->size; i++, e = e->next) {
+            if (e->next->value < e->value) {
+                report(1, "ERROR: Not sorted in ascending order");
+                ok = false;
+            }
         }
-        bool ok = is_size_const();
-        if (!ok) {
-            report(1, "ERROR: Probably not constant time");
-            return false;
+    }
+
+    show_u64queue(3);
+    return ok && !error_check();
+}
+
+static bool show_u64queue(int vlevel)
+{
+    bool ok = true;
+    if (verblevel < vlevel)
+        return true;
+
+    if (!uq) {
+        report(vlevel, "uq = NULL");
+        return true;
+    }
+
+    size_t cnt = 0;
+    const u64q_ele_t *e = uq->head;
+    report_noreturn(vlevel, "uq = [");
+    if (exception_setup(true)) {
+        for (; ok && e && cnt < uq->size; e = e->next, cnt++) {
+            if (cnt < big_queue_size)
+                report_noreturn(vlevel, cnt == 0 ? "%lu" : " %lu", e->value);
         }
-        report(1, "Probably constant time");
-        return ok;
     }
+    exception_cancel();
 
-    if (argc != 1 && argc != 2) {
-        report(1, "%s takes 0-1 arguments", argv[0]);
+    if (e) {
+        report(vlevel, " ... ]");
+        report(1, "ERROR: Integer queue has more than %lu elements",
+               uq->size);
+        ok = false;
+    } else if (cnt != uq->size) {
+        report(vlevel, " ... ]");
+        report(1, "ERROR: Integer queue has %lu elements, but %lu expected",
+               cnt, uq->size);
+        ok = false;
+    } else {
+        report(vlevel, (cnt <= big_queue_size) ? "]" : " ... ]");
+    }
+    return ok;
+}
+
+/* Signal handlers */
+static bool do_aq_new(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
         return false;
     }
 
-    int reps = 1;
     bool ok = true;
-    if (argc != 1 && argc != 2) {
-        report(1, "%s needs 0-1 arguments", argv[0]);
+    if (aq) {
+        report(3, "Freeing old arena queue");
+        ok = do_aq_free(argc, argv);
+    }
+    error_check();
+
+    if (exception_setup(true))
+        aq = aq_new();
+    exception_cancel();
+    show_aqueue(3);
+
+    return ok && !error_check();
+}
+
+static bool do_aq_free(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
         return false;
     }
 
-    if (argc == 2) {
-        if (!get_int(argv[1], &reps)) {
-            report(1, "Invalid number of calls to size '%s'", argv[2]);
+    if (!aq)
+        report(3, "Warning: Calling free on null arena queue");
+    error_check();
+
+    if (aq_size(aq) > big_queue_size)
+        set_cautious_mode(false);
+    if (exception_setup(true))
+        aq_free(aq);
+    exception_cancel();
+    set_cautious_mode(true);
+
+    aq = NULL;
+    show_aqueue(3);
+
+    bool ok = leak_check();
+    return ok && !error_check();
+}
+
+/* Insert a string, or random ones, at the head or tail of the arena queue */
+static bool aq_insert(int argc, char *argv[], bool tail)
+{
+    char randstr_buf[MAX_RANDSTR_LEN];
+    long reps = 1;
+    bool ok = true, need_rand = false;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    char *inserts = argv[1];
+    if (argc == 3) {
+        if (!get_long(argv[2], &reps)) {
+            report(1, "Invalid number of insertions '%s'", argv[2]);
+            return false;
         }
     }
 
-    int cnt = 0;
-    if (!q)
-        report(3, "Warning: Calling size on null queue");
+    if (!strcmp(inserts, "RAND")) {
+        need_rand = true;
+        inserts = randstr_buf;
+    }
+
+    if (!aq)
+        report(3, "Warning: Calling insert %s on null arena queue",
+               (tail) ? "tail" : "head");
     error_check();
 
     if (exception_setup(true)) {
-        for (int r = 0; ok && r < reps; r++) {
-            cnt = q_size(q);
+        for (long r = 0; ok && r < reps; r++) {
+            if (need_rand)
+                fill_rand_string(randstr_buf, sizeof(randstr_buf));
+            bool rval = (tail) ? aq_insert_tail(aq, inserts)
+                               : aq_insert_head(aq, inserts);
+            if (!rval) {
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Insertion of %s failed", inserts);
+                else {
+                    report(1,
+                           "ERROR: Insertion of %s failed (%d failures total)",
+                           inserts, fail_count);
+                    ok = false;
+                }
+            }
             ok = ok && !error_check();
         }
     }
     exception_cancel();
 
-    if (ok) {
-        if (qcnt == cnt) {
-            report(2, "Queue size = %d", cnt);
+    ok = show_aqueue(3) && ok;
+    return ok;
+}
+
+static bool do_aq_insert_head(int argc, char *argv[])
+{
+    return aq_insert(argc, argv, false);
+}
+
+static bool do_aq_insert_tail(int argc, char *argv[])
+{
+    return aq_insert(argc, argv, true);
+}
+
+static bool do_aq_remove(int argc, char *argv[])
+{
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    char *removes = malloc(string_length + 1);
+    if (!removes) {
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for removed strings");
+        return false;
+    }
+
+    bool check = argc > 1;
+    bool ok = true;
+    removes[0] = '\0';
+
+    if (!aq)
+        report(3, "Warning: Calling remove head on null arena queue");
+    else if (aq->head == AQ_NONE)
+        report(3, "Warning: Calling remove head on empty arena queue");
+    error_check();
+
+    bool rval = false;
+    if (exception_setup(true))
+        rval = aq_remove_head(aq, removes, string_length + 1);
+    exception_cancel();
+
+    if (rval) {
+        report(2, "Removed %s from arena queue", removes);
+    } else {
+        fail_count++;
+        if (!check && fail_count < fail_limit) {
+            report(2, "Removal from arena queue failed");
         } else {
             report(1,
-                   "ERROR: Computed queue size as %d, but correct value is %d",
-                   cnt, (int) qcnt);
+                   "ERROR: Removal from arena queue failed (%d failures "
+                   "total)",
+                   fail_count);
             ok = false;
         }
     }
 
-    show_queue(3);
+    if (ok && check && strncmp(removes, argv[1], string_length)) {
+        report(1, "ERROR: Removed value %s != expected value %s", removes,
+               argv[1]);
+        ok = false;
+    }
 
+    ok = show_aqueue(3) && ok;
+
+    free(removes);
     return ok && !error_check();
 }
 
-bool do_sort(int argc, char *argv[])
+static bool do_aq_reverse(int argc, char *argv[])
 {
     if (argc != 1) {
         report(1, "%s takes no arguments", argv[0]);
         return false;
     }
 
-    if (!q)
-        report(3, "Warning: Calling sort on null queue");
+    if (!aq)
+        report(3, "Warning: Calling reverse on null arena queue");
     error_check();
 
-    int cnt = q_size(q);
-    if (cnt < 2)
-        report(3, "Warning: Calling sort on single node");
+    set_noallocate_mode(true);
+    if (exception_setup(true))
+        aq_reverse(aq);
+    exception_cancel();
+
+    set_noallocate_mode(false);
+    show_aqueue(3);
+    return !error_check();
+}
+
+static bool do_aq_sort(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!aq)
+        report(3, "Warning: Calling sort on null arena queue");
     error_check();
 
     const cmp_func_t cmp = cmp_get_func(cmp_func_idx);
     set_noallocate_mode(true);
     if (exception_setup(true))
-        q_sort(q, cmp);
+        aq_sort(aq, cmp);
     exception_cancel();
     set_noallocate_mode(false);
 
     bool ok = true;
-    if (q && q->head) {
-        for (list_ele_t *e = q->head; e->next && --cnt; e = e->next) {
-            /* Ensure each element in ascending order */
-            if (cmp(e->value, e->next->value) > 0) {
+    if (aq) {
+        uint32_t i = aq->head;
+        for (size_t k = 1; ok && i != AQ_NONE && k < aq->size; k++) {
+            const uint32_t next = aq->slots[i].next;
+            if (cmp(aq_value(aq, i), aq_value(aq, next)) > 0) {
                 report(1, "ERROR: Not sorted in ascending order");
                 ok = false;
-                break;
             }
+            i = next;
         }
     }
 
-    show_queue(3);
+    show_aqueue(3);
     return ok && !error_check();
 }
 
-static bool show_queue(int vlevel)
+static bool show_aqueue(int vlevel)
 {
     bool ok = true;
     if (verblevel < vlevel)
         return true;
 
-    int cnt = 0;
-    if (!q) {
-        report(vlevel, "q = NULL");
+    if (!aq) {
+        report(vlevel, "aq = NULL");
         return true;
     }
 
-    report_noreturn(vlevel, "q = [");
-    list_ele_t *e = q->head;
+    size_t cnt = 0;
+    uint32_t i = aq->head;
+    report_noreturn(vlevel, "aq = [");
     if (exception_setup(true)) {
-        while (ok && e && cnt < qcnt) {
+        for (; ok && i != AQ_NONE && cnt < aq->size;
+             i = aq->slots[i].next, cnt++) {
             if (cnt < big_queue_size)
-                report_noreturn(vlevel, cnt == 0 ? "%s" : " %s", e->value);
-            e = e->next;
-            cnt++;
-            ok = ok && !error_check();
+                report_noreturn(vlevel, cnt == 0 ? "%s" : " %s",
+                                aq_value(aq, i));
         }
     }
     exception_cancel();
 
-    if (!ok) {
+    if (i != AQ_NONE) {
         report(vlevel, " ... ]");
-        return false;
-    }
-
-    if (!e) {
-        if (cnt <= big_queue_size)
-            report(vlevel, "]");
-        else
-            report(vlevel, " ... ]");
-    } else {
+        report(1, "ERROR: Arena queue has more than %lu elements", aq->size);
+        ok = false;
+    } else if (cnt != aq->size) {
         report(vlevel, " ... ]");
-        report(
-            vlevel,
-            "ERROR:  Either list has cycle, or queue has more than %d elements",
-            qcnt);
+        report(1, "ERROR: Arena queue has %lu elements, but %lu expected",
+               cnt, aq->size);
         ok = false;
+    } else {
+        report(vlevel, (cnt <= big_queue_size) ? "]" : " ... ]");
     }
-
     return ok;
 }
 
-static bool do_show(int argc, char *argv[])
-{
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
-        return false;
-    }
-    return show_queue(0);
-}
-
-/* Signal handlers */
 static void sigsegvhandler(int sig)
 {
     report(1,
@@ -661,6 +3306,9 @@ static void queue_init()
 {
     fail_count = 0;
     q = NULL;
+    for (int i = 0; i < MAX_QUEUES; i++)
+        qgroups[i] = i;
+    sort_kernel = keysort_kernel();
     signal(SIGSEGV, sigsegvhandler);
     signal(SIGALRM, sigalrmhandler);
 }
@@ -668,22 +3316,34 @@ static void queue_init()
 static bool queue_quit(int argc, char *argv[])
 {
     report(3, "Freeing queue");
-    if (qcnt > big_queue_size)
+    size_t cnt =
+        qcnt + pqcnt + lru_size(lru) + u64q_size(uq) + aq_size(aq);
+    for (int i = 0; i < MAX_QUEUES; i++)
+        cnt += qcnts[i];
+    if (cnt > big_queue_size)
         set_cautious_mode(false);
 
-    if (exception_setup(true))
-        q_free(q);
+    /* Free the queues in the background while freeing the rest */
+    if (exception_setup(true)) {
+        q_free_async(q);
+        for (int i = 0; i < MAX_QUEUES; i++)
+            q_free_async(queues[i]);
+        pq_free(pq);
+        lru_free(lru);
+        u64q_free(uq);
+        aq_free(aq);
+    }
     exception_cancel();
     set_cautious_mode(true);
 
-    size_t bcnt = allocation_check();
-    if (bcnt > 0) {
-        report(1, "ERROR: Freed queue, but %lu blocks are still allocated",
-               bcnt);
-        return false;
-    }
-
-    return true;
+    q = NULL;
+    for (int i = 0; i < MAX_QUEUES; i++)
+        queues[i] = NULL;
+    pq = NULL;
+    lru = NULL;
+    uq = NULL;
+    aq = NULL;
+    return leak_check();
 }
 
 static void usage(char *cmd)
@@ -1,263 +1,3426 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "compare.h"
 #include "harness.h"
+#include "hash.h"
+#include "keysort.h"
 #include "queue.h"
+#include "reclaim.h"
+
+/* Comparison of values */
 
 /*
- * Create empty queue.
+ * Compare the value `a` of `alen` bytes with the value `b` of `blen` bytes
+ * by `cmp`.
+ * Byte order, either way, compares the lengths known ahead instead of
+ * looking for the ends of the strings, which also orders values holding
+ * zero bytes.  It agrees with strcmp() on values without them.
+ */
+static inline int value_cmp(const char *a,
+                            size_t alen,
+                            const char *b,
+                            size_t blen,
+                            cmp_func_t cmp)
+{
+    if (cmp == strcmp || cmp == negstrcmp) {
+        int c = memcmp(a, b, (alen < blen) ? alen : blen);
+        if (!c)
+            c = (alen > blen) - (alen < blen);
+        return (cmp == strcmp) ? c : -c;
+    }
+    return cmp(a, b);
+}
+
+/* Compare the values of the elements `a` and `b` by `cmp` */
+static inline int ele_cmp(const list_ele_t *a,
+                          const list_ele_t *b,
+                          cmp_func_t cmp)
+{
+    return value_cmp(a->value, a->len, b->value, b->len, cmp);
+}
+
+/* Skip-list index */
+
+/* The maximum number of index levels above the element chain */
+#define SKIP_MAX_LEVEL 32
+
+/*
+ * Index tower of an element.
+ * `next[l]` links to the next tower of height greater than `l`.
+ */
+typedef struct SKIPNODE {
+    list_ele_t *ele;
+    int height;
+    struct SKIPNODE *next[];
+} skip_node_t;
+
+/*
+ * The element chain itself serves as the bottom level, so only about half of
+ * the elements own a tower
+ */
+struct SKIPIDX {
+    cmp_func_t cmp;    /* The ordering the index was built for */
+    bool valid;        /* Whether the queue is still sorted by `cmp` */
+    int level;         /* The number of levels in use */
+    unsigned int seed; /* State of the tower height generator */
+    /* The first tower of each level */
+    skip_node_t *first[SKIP_MAX_LEVEL];
+};
+
+/* Free all towers of `idx` without touching the indexed elements */
+static void skip_clear(struct SKIPIDX *idx)
+{
+    for (skip_node_t *k = idx->first[0]; k;) {
+        skip_node_t *const next = k->next[0];
+        free(k);
+        k = next;
+    }
+    for (int l = 0; l < SKIP_MAX_LEVEL; ++l)
+        idx->first[l] = NULL;
+    idx->level = 0;
+}
+
+/*
+ * Mark the index of `q` as out of date.
+ * The towers are kept until the index is rebuilt, since this can be called
+ * where freeing is not allowed.
+ */
+static void skip_invalidate(queue_t *q)
+{
+    if (q->skip)
+        q->skip->valid = false;
+}
+
+/* Forget the sorted prefix of `q`, after moving elements out of order */
+static void sorted_reset(queue_t *q)
+{
+    q->sorted_len = 0;
+    q->sorted_tail = NULL;
+}
+
+/*
+ * Return a random tower height.
+ * A height of `h` or more is taken with probability 2^-h.
+ */
+static int skip_random_height(struct SKIPIDX *idx)
+{
+    unsigned int r;
+    int h = 0;
+
+    /* xorshift32 */
+    r = idx->seed;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    idx->seed = r;
+
+    while (h < SKIP_MAX_LEVEL - 1 && (r & 1)) {
+        ++h;
+        r >>= 1;
+    }
+    return h;
+}
+
+/*
+ * Return a tower of height `h` for `ele`, or NULL if could not allocate space.
+ * Note: `next` will not be initialized.
+ */
+static skip_node_t *skip_node_alloc(list_ele_t *ele, int h)
+{
+    skip_node_t *const node =
+        malloc(sizeof(skip_node_t) + h * sizeof(skip_node_t *));
+    if (node) {
+        node->ele = ele;
+        node->height = h;
+    }
+    return node;
+}
+
+/*
+ * Search the index of `q` for the last elements preceding the value `s` of
+ * `len` bytes.
+ * An element precedes `s` if it compares less than `s`, or also equal to `s`
+ * when `upper` is set.
+ * Store the last tower preceding `s` at each level into `pred` (NULL for the
+ * head of the level) unless `pred` is NULL.
+ * Return the last element preceding `s`, or NULL if the head does not.
+ */
+static list_ele_t *skip_search(const queue_t *q,
+                               const char *s,
+                               size_t len,
+                               bool upper,
+                               skip_node_t **pred)
+{
+    const struct SKIPIDX *const idx = q->skip;
+    const int bound = (upper) ? 1 : 0;
+    skip_node_t *x = NULL;
+    list_ele_t *prev;
+    list_ele_t *e;
+
+    for (int l = idx->level - 1; l >= 0; --l) {
+        skip_node_t *next = (x) ? x->next[l] : idx->first[l];
+        while (next && value_cmp(next->ele->value, next->ele->len, s, len,
+                                 idx->cmp) < bound) {
+            x = next;
+            next = x->next[l];
+        }
+        if (pred)
+            pred[l] = x;
+    }
+
+    /* Finish on the element chain */
+    prev = (x) ? x->ele : NULL;
+    e = (prev) ? prev->next : q->head;
+    while (e && value_cmp(e->value, e->len, s, len, idx->cmp) < bound) {
+        prev = e;
+        e = e->next;
+    }
+    return prev;
+}
+
+/* Preallocated storage of a bounded queue */
+struct QPOOL {
+    size_t capacity;       /* The maximum number of elements */
+    size_t max_strlen;     /* The maximum length of stored strings */
+    bool overwrite;        /* Drop the head instead of failing when full */
+    char *strings;         /* String slots of `max_strlen` + 1 bytes */
+    list_ele_t *free_list; /* Unused nodes, linked by `next` */
+    list_ele_t nodes[];    /* Node slots */
+};
+
+/* Hash index */
+
+/* Entry of the index for each distinct value */
+typedef struct {
+    size_t count; /* The number of elements holding `key` */
+    char key[];   /* Copy of the value */
+} index_entry_t;
+
+/*
+ * Counts of the values of a queue.
+ * The entries own copies of the values, so that the index depends on
+ * neither the order nor the identity of elements.
+ */
+struct QINDEX {
+    hash_table_t table;
+};
+
+/* Return the key of an index entry */
+static const char *index_entry_key(const void *item)
+{
+    return ((const index_entry_t *) item)->key;
+}
+
+/*
+ * Count one more element holding `s`.
+ * Return false if could not allocate space.
+ */
+static bool index_add(struct QINDEX *idx, const char *s)
+{
+    const uint32_t hv = hash_str(s);
+    index_entry_t *entry = hash_find(&idx->table, s, hv);
+    if (entry) {
+        ++entry->count;
+        return true;
+    }
+
+    const size_t len = strlen(s) + 1;
+    entry = malloc(sizeof(index_entry_t) + len);
+    if (!entry)
+        return false;
+    entry->count = 1;
+    memcpy(entry->key, s, len);
+    if (!hash_insert(&idx->table, entry, hv)) {
+        free(entry);
+        return false;
+    }
+    return true;
+}
+
+/* Count one less element holding `s`, which must be counted */
+static void index_remove(struct QINDEX *idx, const char *s)
+{
+    const uint32_t hv = hash_str(s);
+    index_entry_t *const entry = hash_find(&idx->table, s, hv);
+    if (entry && --entry->count == 0) {
+        hash_remove(&idx->table, entry, hv);
+        free(entry);
+    }
+}
+
+/* Free `idx` with all its entries */
+static void index_free(struct QINDEX *idx)
+{
+    for (size_t k = 0; k < idx->table.capacity; ++k)
+        free(idx->table.slots[k].item);
+    hash_destroy(&idx->table);
+    free(idx);
+}
+
+/* Spilling to disk */
+
+/* Segment of spilled records in the file */
+typedef struct {
+    size_t off;   /* The offset of the first record, aligned to a page */
+    size_t bytes; /* The size of the records */
+    size_t count; /* The number of records */
+} spill_seg_t;
+
+/*
+ * Elements spilled from the middle of a queue.
+ * The queue is made of the front list from `head`, then the segments from
+ * the oldest, then the back list from `back` to `tail`.
+ * A record holds the size of the value including its terminator, and the
+ * value itself, as in run files.  The file stays mapped, so that the
+ * iterator can read the values in place.
+ */
+struct QSPILL {
+    size_t seg_len;    /* The number of elements per segment */
+    list_ele_t *back;  /* The back list, or NULL if empty */
+    size_t back_len;   /* The length of the back list */
+    size_t spilled;    /* The number of elements in the segments */
+    FILE *file;        /* The file of segments, or NULL until needed */
+    char *map;         /* Shared mapping of the whole file */
+    size_t map_size;   /* The size of the file and of `map` */
+    size_t end;        /* The end of the newest segment */
+    spill_seg_t *segs; /* Ring of segments */
+    size_t first;      /* The oldest segment in `segs` */
+    size_t nsegs;      /* The number of segments */
+    size_t cap;        /* The capacity of `segs` */
+};
+
+/* Free the file and the segments of `sp`, but not its back list */
+static void spill_free(struct QSPILL *sp)
+{
+    if (sp->map)
+        munmap(sp->map, sp->map_size);
+    if (sp->file)
+        fclose(sp->file);
+    free(sp->segs);
+    free(sp);
+}
+
+/* Segment index */
+
+/*
+ * Pointers to every `k`-th element of a queue, from the one at position
+ * `off` on.
+ * They are kept in a ring, so that entries come and go at both ends in
+ * O(1), and head insertion and removal shift `off` instead of the entries.
+ */
+struct QSEGIDX {
+    size_t k;          /* The distance between indexed elements */
+    bool valid;        /* Whether the entries match the queue */
+    size_t off;        /* The position of the first entry, less than `k` */
+    list_ele_t **ring; /* Ring of entries */
+    size_t first;      /* The first entry in `ring` */
+    size_t count;      /* The number of entries */
+    size_t cap;        /* The capacity of `ring` */
+    size_t updates;    /* The number of entries added or dropped in place */
+    size_t rebuilds;   /* The number of times it was built from scratch */
+};
+
+/*
+ * Mark the segment index of `q` as out of date, after moving elements
+ * around. It is rebuilt on next use.
+ */
+static void seg_invalidate(queue_t *q)
+{
+    if (q->seg)
+        q->seg->valid = false;
+}
+
+/*
+ * Make the ring of `idx` hold at least `cap` entries.
+ * Return false if could not allocate space.
+ */
+static bool seg_reserve(struct QSEGIDX *idx, size_t cap)
+{
+    list_ele_t **ring;
+
+    if (cap <= idx->cap)
+        return true;
+    if (cap > SIZE_MAX / sizeof(list_ele_t *))
+        return false;
+    ring = malloc(cap * sizeof(list_ele_t *));
+    if (!ring)
+        return false;
+    for (size_t i = 0; i < idx->count; ++i)
+        ring[i] = idx->ring[(idx->first + i) % idx->cap];
+    free(idx->ring);
+    idx->ring = ring;
+    idx->first = 0;
+    idx->cap = cap;
+    return true;
+}
+
+/*
+ * Make room for one more entry in `idx`.
+ * The index is left out of date if could not allocate space.
+ */
+static bool seg_room(struct QSEGIDX *idx)
+{
+    if (idx->count < idx->cap ||
+        seg_reserve(idx, (idx->cap) ? 2 * idx->cap : 16))
+        return true;
+    idx->valid = false;
+    return false;
+}
+
+/* Index `newh`, just inserted at the head of `q`, if it is at a multiple */
+static void seg_insert_head(queue_t *q, list_ele_t *newh)
+{
+    struct QSEGIDX *const idx = q->seg;
+
+    if (!idx || !idx->valid)
+        return;
+    if (++idx->off < idx->k || !seg_room(idx))
+        return;
+    idx->first = (idx->first + idx->cap - 1) % idx->cap;
+    idx->ring[idx->first] = newh;
+    ++idx->count;
+    ++idx->updates;
+    idx->off = 0;
+}
+
+/*
+ * Index `newh`, about to be counted at the tail of `q`, if it is at a
+ * multiple
+ */
+static void seg_insert_tail(queue_t *q, list_ele_t *newh)
+{
+    struct QSEGIDX *const idx = q->seg;
+    const size_t pos = q->size;
+
+    if (!idx || !idx->valid || pos < idx->off ||
+        (pos - idx->off) % idx->k || !seg_room(idx))
+        return;
+    idx->ring[(idx->first + idx->count++) % idx->cap] = newh;
+    ++idx->updates;
+}
+
+/* Drop the entry of the head of `q`, about to be removed, if any */
+static void seg_remove_head(queue_t *q)
+{
+    struct QSEGIDX *const idx = q->seg;
+
+    if (!idx || !idx->valid)
+        return;
+    if (idx->off) {
+        --idx->off;
+        return;
+    }
+    idx->first = (idx->first + 1) % idx->cap;
+    --idx->count;
+    ++idx->updates;
+    idx->off = idx->k - 1;
+}
+
+/*
+ * Rebuild the segment index of `q`, which has no element on disk, in one
+ * pass.
+ * Return false if could not allocate space.
+ */
+static bool seg_rebuild(queue_t *q)
+{
+    struct QSEGIDX *const idx = q->seg;
+    size_t pos = 0;
+
+    if (!seg_reserve(idx, q->size / idx->k + 1))
+        return false;
+    idx->first = idx->count = idx->off = 0;
+    for (list_ele_t *e = q->head; e; e = e->next) {
+        if (!(pos++ % idx->k))
+            idx->ring[idx->count++] = e;
+    }
+    idx->valid = true;
+    ++idx->rebuilds;
+    return true;
+}
+
+/*
+ * Return the element at position `pos` of `q`, which has no element on
+ * disk and more than `pos` elements.
+ * It takes O(k) steps with a segment index, which is rebuilt if out of
+ * date, and O(pos) steps otherwise.
+ */
+static list_ele_t *ele_at(queue_t *q, size_t pos)
+{
+    struct QSEGIDX *const idx = q->seg;
+    list_ele_t *e = q->head;
+    size_t steps = pos;
+
+    if (idx && (idx->valid || seg_rebuild(q)) && pos >= idx->off) {
+        e = idx->ring[(idx->first + (pos - idx->off) / idx->k) % idx->cap];
+        steps = (pos - idx->off) % idx->k;
+    }
+    while (steps--)
+        e = e->next;
+    return e;
+}
+
+/* Compaction */
+
+/* The size of the blocks which compaction lays elements out in */
+#define COMPACT_BLOCK (64 << 10)
+
+/* The size and alignment of the regions taken from huge pages */
+#define HUGE_REGION (2 << 20)
+
+/*
+ * Block of elements laid out by compaction, or allocated from huge pages.
+ * Each element takes a pointer to its block, its node and then its string,
+ * rounded up to a multiple of 8 bytes.  The block is freed along with the
+ * last of its elements.
+ * A region of huge pages is mapped directly. The size of the mapping is
+ * kept in a block of malloc, so that a region left behind shows up as a
+ * leak like any other block.
+ */
+typedef struct {
+    size_t live;    /* The elements in the block, plus one while it is filled */
+    size_t *mapped; /* The size of the mapped region, or NULL if allocated */
+} compact_block_t;
+
+/* State of the compaction pass over a queue */
+struct QCOMPACT {
+    list_ele_t *last;       /* The last element moved, or NULL */
+    compact_block_t *block; /* The block being filled, or NULL */
+    size_t used;            /* The bytes taken in `block` */
+    size_t size;            /* The size of `block` */
+};
+
+/* State of the allocation of elements from huge pages */
+struct QHUGE {
+    q_huge_t mode;          /* Where regions are taken from */
+    compact_block_t *block; /* The region being filled, or NULL */
+    size_t used;            /* The bytes taken in `block` */
+    q_huge_stats_t stats;   /* Regions mapped so far */
+};
+
+/* Free `block`, whose elements are all gone */
+static void block_free(compact_block_t *block)
+{
+    if (block->mapped) {
+        size_t *const mapped = block->mapped;
+        munmap(block, *mapped);
+        free(mapped);
+    } else {
+        free(block);
+    }
+}
+
+/*
+ * Map a region of huge pages for `hp`: reserved ones if asked for and
+ * available, or else transparent ones, advised on a region cut out at a
+ * 2 MiB boundary from a larger mapping.  The region is of small pages if
+ * the kernel does not honor the advice.
  * Return NULL if could not allocate space.
  */
-queue_t *q_new()
+static compact_block_t *huge_map(struct QHUGE *hp)
 {
-    queue_t *q = malloc(sizeof(queue_t));
-    if (q) {
-        q->head = NULL;
-        q->tail = NULL;
-        q->size = 0;
+    size_t *const mapped = malloc(sizeof(size_t));
+    char *map = MAP_FAILED;
+    compact_block_t *block;
+
+    if (!mapped)
+        return NULL;
+#ifdef MAP_HUGETLB
+    if (hp->mode == Q_HUGE_TLB) {
+        map = mmap(NULL, HUGE_REGION, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (map != MAP_FAILED)
+            ++hp->stats.hugetlb;
+    }
+#endif
+    if (map == MAP_FAILED) {
+        char *const raw = mmap(NULL, 2 * HUGE_REGION, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            free(mapped);
+            return NULL;
+        }
+        map = (char *) (((uintptr_t) raw + HUGE_REGION - 1) &
+                        ~(uintptr_t) (HUGE_REGION - 1));
+        if (map != raw)
+            munmap(raw, map - raw);
+        munmap(map + HUGE_REGION, raw + HUGE_REGION - map);
+#ifdef MADV_HUGEPAGE
+        if (!madvise(map, HUGE_REGION, MADV_HUGEPAGE))
+            ++hp->stats.advised;
+#endif
+    }
+
+    ++hp->stats.regions;
+    *mapped = HUGE_REGION;
+    block = (compact_block_t *) map;
+    block->live = 1;
+    block->mapped = mapped;
+    return block;
+}
+
+/*
+ * Return a new block of at least `need` bytes to fill with elements of `q`,
+ * taking a region of huge pages if the queue allocates from them, and set
+ * *size to its size.
+ * Return NULL if could not allocate space.
+ */
+static compact_block_t *block_new(queue_t *q, size_t need, size_t *size)
+{
+    compact_block_t *block;
+
+    if (q->huge && q->huge->mode != Q_HUGE_OFF && need <= HUGE_REGION) {
+        block = huge_map(q->huge);
+        if (block) {
+            *size = HUGE_REGION;
+            return block;
+        }
+    }
+    *size = (need > COMPACT_BLOCK) ? need : COMPACT_BLOCK;
+    block = malloc(*size);
+    if (block) {
+        block->live = 1;
+        block->mapped = NULL;
+    }
+    return block;
+}
+
+/* Return the bytes taken in a block by an element with a value of `len` */
+static size_t block_need(size_t len)
+{
+    return (sizeof(compact_block_t *) + sizeof(list_ele_t) + len + 1 + 7) &
+           ~(size_t) 7;
+}
+
+/*
+ * Lay out an element holding the `len` bytes of `s` at `p` in `block`.
+ * Note: the `next` of the element will not be initialized.
+ */
+static list_ele_t *block_put(compact_block_t *block,
+                             char *p,
+                             const char *s,
+                             size_t len)
+{
+    list_ele_t *const e = (list_ele_t *) (p + sizeof(compact_block_t *));
+
+    ++block->live;
+    *(compact_block_t **) p = block;
+    e->value = (char *) (e + 1);
+    memcpy(e->value, s, len);
+    e->value[len] = '\0';
+    e->len = len;
+    return e;
+}
+
+/*
+ * Free the element `e` of `q` with its string.
+ * An element laid out in a block has its string right after its node,
+ * where no separate allocation by malloc can start.  An allocator of the
+ * queue may put them there, but its queue has no blocks.
+ */
+static void ele_free(const queue_t *q, list_ele_t *e)
+{
+    if (q->alloc) {
+        allocator_t *const a = q->alloc;
+        a->release(a, e->value, e->len + 1);
+        a->release(a, e, sizeof(list_ele_t));
+        return;
+    }
+    if (e->value == (char *) (e + 1)) {
+        compact_block_t *const block = ((compact_block_t **) e)[-1];
+        if (!--block->live)
+            block_free(block);
+        return;
+    }
+    free(e->value);
+    free(e);
+}
+
+/* Stop filling the block of `cp`, freeing it if none of its elements is left */
+static void compact_release(struct QCOMPACT *cp)
+{
+    if (cp->block && !--cp->block->live)
+        block_free(cp->block);
+    cp->block = NULL;
+}
+
+/* Stop filling the region of `hp`, unmapping it if no element is left */
+static void huge_release(struct QHUGE *hp)
+{
+    if (hp->block && !--hp->block->live)
+        block_free(hp->block);
+    hp->block = NULL;
+}
+
+/*
+ * Make the next compaction of `q` start a new pass from the head, after
+ * moving elements out of order
+ */
+static void compact_restart(queue_t *q)
+{
+    if (q->compact)
+        q->compact->last = NULL;
+}
+
+/*
+ * Move the element `x` of `q`, which follows `prev` or is the head if
+ * `prev` is NULL, into the block being filled.
+ * Return the moved element, or NULL, with no effect, if could not allocate
+ * space.
+ */
+static list_ele_t *compact_move(queue_t *q, list_ele_t *prev, list_ele_t *x)
+{
+    struct QCOMPACT *const cp = q->compact;
+    const size_t need = block_need(x->len);
+    list_ele_t *e;
+
+    if (!cp->block || cp->size - cp->used < need) {
+        size_t size;
+        compact_block_t *const block =
+            block_new(q, sizeof(compact_block_t) + need, &size);
+        if (!block)
+            return NULL;
+        compact_release(cp);
+        cp->block = block;
+        cp->used = sizeof(compact_block_t);
+        cp->size = size;
+    }
+
+    e = block_put(cp->block, (char *) cp->block + cp->used, x->value, x->len);
+    cp->used += need;
+
+    e->next = x->next;
+    if (prev)
+        prev->next = e;
+    else
+        q->head = e;
+    if (q->tail == x)
+        q->tail = e;
+    if (q->sorted_tail == x)
+        q->sorted_tail = e;
+    ele_free(q, x);
+    return e;
+}
+
+/* Interleaved traversal */
+
+/* The most chains of elements walked at once */
+#define CHAIN_WAYS 8
+
+/*
+ * Split the list of `q` into chains which can be walked independently,
+ * taking evenly spaced elements of a valid segment index, or else of a
+ * level of a valid skip index with few towers.  starts[0] is the head, and
+ * each chain ends where the next one starts.
+ * Return the number of chains, which is 1 without an index in use or with
+ * elements on disk.
+ */
+static size_t chain_split(const queue_t *q, list_ele_t **starts)
+{
+    const struct QSEGIDX *const seg = q->seg;
+    const struct SKIPIDX *const skip = q->skip;
+    size_t ways = 1;
+
+    starts[0] = q->head;
+    if (q->spill && (q->spill->nsegs || q->spill->back))
+        return 1;
+
+    if (seg && seg->valid && seg->count > 1) {
+        ways = (seg->count < CHAIN_WAYS) ? seg->count : CHAIN_WAYS;
+        for (size_t c = 1; c < ways; ++c)
+            starts[c] = seg->ring[(seg->first + c * seg->count / ways) %
+                                  seg->cap];
+    } else if (skip && skip->valid && skip->level) {
+        /* Go down to the first level with enough towers */
+        int l = skip->level;
+        size_t towers;
+        do {
+            towers = 0;
+            --l;
+            for (const skip_node_t *x = skip->first[l]; x; x = x->next[l])
+                ++towers;
+        } while (towers < CHAIN_WAYS && l > 0);
+        if (towers < 2)
+            return 1;
+
+        ways = (towers < CHAIN_WAYS) ? towers : CHAIN_WAYS;
+        const skip_node_t *x = skip->first[l];
+        for (size_t c = 1, i = 0; c < ways; ++c) {
+            for (; i < c * towers / ways; ++i)
+                x = x->next[l];
+            starts[c] = x->ele;
+        }
+    }
+    return ways;
+}
+
+/*
+ * Free the elements of `q` in the `ways` chains from `starts`, a step of
+ * each chain at a time.
+ * Each round loads the next elements of all chains and prefetches their
+ * successors and strings before freeing any, so that the cache misses of
+ * the chains overlap instead of following one another.
+ */
+static void chain_free(const queue_t *q, list_ele_t **starts, size_t ways)
+{
+    list_ele_t *cur[CHAIN_WAYS], *next[CHAIN_WAYS];
+    size_t live = ways;
+
+    for (size_t c = 0; c < ways; ++c)
+        cur[c] = starts[c];
+    while (live) {
+        live = 0;
+        for (size_t c = 0; c < ways; ++c) {
+            list_ele_t *const e = cur[c];
+            const list_ele_t *const end = (c + 1 < ways) ? starts[c + 1] : NULL;
+            next[c] = (e == end) ? e : e->next;
+            if (e != end) {
+                __builtin_prefetch(next[c]);
+                __builtin_prefetch(e->value);
+            }
+        }
+        for (size_t c = 0; c < ways; ++c) {
+            if (cur[c] == next[c])
+                continue;
+            ele_free(q, cur[c]);
+            cur[c] = next[c];
+            ++live;
+        }
+    }
+}
+
+/*
+ * Reverse the list of `q` split into the `ways` chains from `starts`, a step
+ * of each chain at a time, prefetching the successor of each for writing.
+ * Each chain is reversed in place, then its first element is linked to the
+ * last one of the previous chain.
+ * A single chain takes a plain loop, which keeps the walk in registers.
+ */
+static void chain_reverse(queue_t *q, list_ele_t **starts, size_t ways)
+{
+    list_ele_t *cur[CHAIN_WAYS], *prev[CHAIN_WAYS];
+    size_t live = ways;
+
+    if (ways == 1) {
+        list_ele_t *p = NULL;
+        for (list_ele_t *k = q->head; k;) {
+            list_ele_t *const next = k->next;
+            k->next = p;
+            p = k;
+            k = next;
+        }
+        q->tail = q->head;
+        q->head = p;
+        return;
+    }
+
+    for (size_t c = 0; c < ways; ++c) {
+        cur[c] = starts[c];
+        prev[c] = NULL;
+    }
+    while (live) {
+        live = 0;
+        for (size_t c = 0; c < ways; ++c) {
+            list_ele_t *const e = cur[c];
+            if (e == ((c + 1 < ways) ? starts[c + 1] : NULL))
+                continue;
+            list_ele_t *const next = e->next;
+            __builtin_prefetch(next, 1);
+            e->next = prev[c];
+            prev[c] = e;
+            cur[c] = next;
+            ++live;
+        }
+    }
+    for (size_t c = 1; c < ways; ++c)
+        starts[c]->next = prev[c - 1];
+
+    /* `prev[ways - 1]` is now the original tail */
+    q->tail = q->head;
+    q->head = prev[ways - 1];
+}
+
+/*
+ * Create empty queue.
+ * Return NULL if could not allocate space.
+ */
+queue_t *q_new()
+{
+    queue_t *q = malloc(sizeof(queue_t));
+    if (q) {
+        q->head = NULL;
+        q->tail = NULL;
+        q->size = 0;
+        q->skip = NULL;
+        q->pool = NULL;
+        q->scratch = NULL;
+        q->scratch_size = 0;
+        q->index = NULL;
+        q->sort_budget = 0;
+        q->spill = NULL;
+        q->sorted_cmp = NULL;
+        q->sorted_len = 0;
+        q->sorted_tail = NULL;
+        q->seg = NULL;
+        q->compact = NULL;
+        q->huge = NULL;
+        q->alloc = NULL;
+    }
+    return q;
+}
+
+/*
+ * Create empty queue taking its elements from `a`, which it owns.
+ * Return NULL if could not allocate space.
+ */
+queue_t *q_new_with_allocator(allocator_t *a)
+{
+    queue_t *q;
+
+    if (!a)
+        return NULL;
+    q = q_new();
+    if (q)
+        q->alloc = a;
+    return q;
+}
+
+/*
+ * Create empty queue holding at most `capacity` strings of at most
+ * `max_strlen` characters.
+ * All the space is allocated up front; the queue never allocates afterwards.
+ * Return NULL if could not allocate space or `capacity` is 0.
+ */
+queue_t *q_new_bounded(size_t capacity, size_t max_strlen)
+{
+    struct QPOOL *pool;
+    queue_t *q;
+
+    if (!capacity || max_strlen + 1 > SIZE_MAX / capacity ||
+        capacity > (SIZE_MAX - sizeof(struct QPOOL)) / sizeof(list_ele_t))
+        return NULL;
+
+    q = q_new();
+    if (!q)
+        return NULL;
+    pool = malloc(sizeof(struct QPOOL) + capacity * sizeof(list_ele_t));
+    if (!pool) {
+        free(q);
+        return NULL;
+    }
+    pool->strings = malloc(capacity * (max_strlen + 1));
+    if (!pool->strings) {
+        free(pool);
+        free(q);
+        return NULL;
+    }
+
+    pool->capacity = capacity;
+    pool->max_strlen = max_strlen;
+    pool->overwrite = false;
+    pool->free_list = NULL;
+    for (size_t k = capacity; k-- > 0;) {
+        pool->nodes[k].value = pool->strings + k * (max_strlen + 1);
+        pool->nodes[k].next = pool->free_list;
+        pool->free_list = &pool->nodes[k];
+    }
+    q->pool = pool;
+    return q;
+}
+
+/*
+ * Make a full bounded queue drop its head on tail insertion instead of
+ * refusing the new element, so that it works as a ring log.
+ * No effect if q is NULL or not bounded.
+ */
+void q_set_overwrite(queue_t *q, bool overwrite)
+{
+    if (q && q->pool)
+        q->pool->overwrite = overwrite;
+}
+
+/*
+ * Return the maximum number of elements of a bounded queue.
+ * Return 0 if q is NULL or not bounded.
+ */
+size_t q_capacity(const queue_t *q)
+{
+    return (q && q->pool) ? q->pool->capacity : 0;
+}
+
+/* Free all storage used by queue */
+void q_free(queue_t *q)
+{
+    if (!q)
+        return;
+
+    /* Free queue elements */
+    if (q->pool) {
+        free(q->pool->strings);
+        free(q->pool);
+    } else if (q->head) {
+        list_ele_t *starts[CHAIN_WAYS];
+        chain_free(q, starts, chain_split(q, starts));
+    }
+    if (q->spill) {
+        for (list_ele_t *k = q->spill->back; k;) {
+            list_ele_t *const next = k->next;
+            ele_free(q, k);
+            k = next;
+        }
+        spill_free(q->spill);
+    }
+    /* Free the index */
+    if (q->skip) {
+        skip_clear(q->skip);
+        free(q->skip);
+    }
+    free(q->scratch);
+    if (q->index)
+        index_free(q->index);
+    if (q->seg) {
+        free(q->seg->ring);
+        free(q->seg);
+    }
+    if (q->compact) {
+        compact_release(q->compact);
+        free(q->compact);
+    }
+    if (q->huge) {
+        huge_release(q->huge);
+        free(q->huge);
+    }
+    alloc_destroy(q->alloc);
+    /* Free queue structure */
+    free(q);
+}
+
+/* Free queue on the reclaimer thread */
+static void q_free_job(void *q)
+{
+    q_free(q);
+}
+
+/* Free all storage used by queue in the background */
+void q_free_async(queue_t *q)
+{
+    if (q)
+        reclaim_submit(q, q_free_job);
+}
+
+/*
+ * Return `NULL` if could not allocate space.
+ * Return non-`NULL` if successful.
+ * Argument `s` points to the `len` bytes to be stored, which are followed by
+ * a zero byte in the element.
+ * The element is taken from `a`, or from malloc if `a` is NULL.
+ * Note: `newh->next` will not be initialized.
+ */
+static list_ele_t *ele_alloc(allocator_t *a, const char *s, size_t len)
+{
+    if (a) {
+        list_ele_t *const newh = a->alloc(a, sizeof(list_ele_t));
+        if (!newh)
+            return NULL;
+        newh->value = a->alloc(a, len + 1);
+        if (!newh->value) {
+            a->release(a, newh, sizeof(list_ele_t));
+            return NULL;
+        }
+        memcpy(newh->value, s, len);
+        newh->value[len] = '\0';
+        newh->len = len;
+        return newh;
+    }
+
+    /* Don't forget to allocate space for the string and copy it */
+    list_ele_t *const newh = malloc(sizeof(list_ele_t));
+    if (newh) {
+        newh->value = malloc(len + 1);
+        if (newh->value) {
+            memcpy(newh->value, s, len);
+            newh->value[len] = '\0';
+            newh->len = len;
+        } else {
+            /* What if either call to malloc returns NULL? */
+            free(newh);
+            return NULL;
+        }
+    }
+    return newh;
+}
+
+/*
+ * Allocate an element holding the `len` bytes of `s` in the region of huge
+ * pages being filled for `q`, mapping a new region once it is full.
+ * Fall back to `ele_alloc()` if the element does not fit in a region, or no
+ * region could be mapped.
+ * Note: `newh->next` will not be initialized.
+ */
+static list_ele_t *huge_alloc(queue_t *q, const char *s, size_t len)
+{
+    struct QHUGE *const hp = q->huge;
+    const size_t need = block_need(len);
+    list_ele_t *newh;
+
+    if (sizeof(compact_block_t) + need > HUGE_REGION)
+        return ele_alloc(q->alloc, s, len);
+    if (!hp->block || HUGE_REGION - hp->used < need) {
+        compact_block_t *const block = huge_map(hp);
+        if (!block)
+            return ele_alloc(q->alloc, s, len);
+        huge_release(hp);
+        hp->block = block;
+        hp->used = sizeof(compact_block_t);
+    }
+    newh = block_put(hp->block, (char *) hp->block + hp->used, s, len);
+    hp->used += need;
+    return newh;
+}
+
+/*
+ * Take a node of the bounded queue `q` and copy the `len` bytes of `s` into
+ * its slot, truncated to the maximum length, or allocate the node if `q` is
+ * not bounded.
+ * The value is counted by the hash index of `q`, if any.
+ * Return `NULL` if there is no space.
+ * Note: `newh->next` will not be initialized.
+ */
+static list_ele_t *ele_new(queue_t *q, const char *s, size_t len)
+{
+    struct QPOOL *const pool = q->pool;
+    list_ele_t *newh;
+
+    if (!pool) {
+        newh = (q->huge && q->huge->mode != Q_HUGE_OFF)
+                   ? huge_alloc(q, s, len)
+                   : ele_alloc(q->alloc, s, len);
+    } else {
+        newh = pool->free_list;
+        if (newh) {
+            pool->free_list = newh->next;
+            if (len > pool->max_strlen)
+                len = pool->max_strlen;
+            memcpy(newh->value, s, len);
+            newh->value[len] = '\0';
+            newh->len = len;
+        }
+    }
+
+    if (newh && q->index && !index_add(q->index, newh->value)) {
+        if (pool) {
+            newh->next = pool->free_list;
+            pool->free_list = newh;
+        } else {
+            ele_free(q, newh);
+        }
+        return NULL;
+    }
+    return newh;
+}
+
+/* Release the node `e` taken by `ele_new()` */
+static void ele_delete(queue_t *q, list_ele_t *e)
+{
+    if (q->index)
+        index_remove(q->index, e->value);
+    if (q->pool) {
+        e->next = q->pool->free_list;
+        q->pool->free_list = e;
+    } else {
+        ele_free(q, e);
+    }
+}
+
+/* Whether `q` is bounded and has no space left */
+static bool q_full(const queue_t *q)
+{
+    return q->pool && q->size >= q->pool->capacity;
+}
+
+typedef struct {
+    list_ele_t *head;
+    list_ele_t *tail;
+} list_span_t;
+
+/* Round `n` up to a multiple of the page size */
+static size_t page_round(size_t n)
+{
+    const size_t page = sysconf(_SC_PAGESIZE);
+    return (n + page - 1) / page * page;
+}
+
+/*
+ * Make the file of `sp` at least `size` bytes, doubling it and mapping it
+ * again as it grows.
+ * Return false if could not create or grow the file.
+ */
+static bool spill_grow(struct QSPILL *sp, size_t size)
+{
+    size_t grown;
+    void *map;
+
+    if (size <= sp->map_size)
+        return true;
+    if (!sp->file) {
+        sp->file = tmpfile();
+        if (!sp->file)
+            return false;
+    }
+    grown = page_round((size > 2 * sp->map_size) ? size : 2 * sp->map_size);
+    if (ftruncate(fileno(sp->file), grown) < 0)
+        return false;
+    map = mmap(NULL, grown, PROT_READ | PROT_WRITE, MAP_SHARED,
+               fileno(sp->file), 0);
+    if (map == MAP_FAILED)
+        return false;
+    if (sp->map)
+        munmap(sp->map, sp->map_size);
+    sp->map = map;
+    sp->map_size = grown;
+    return true;
+}
+
+/* Drop the pages of the segment `seg` of `sp`, which the file keeps */
+static void seg_drop(const struct QSPILL *sp, const spill_seg_t *seg)
+{
+    madvise(sp->map + seg->off, page_round(seg->bytes), MADV_DONTNEED);
+}
+
+/*
+ * Write the first `count` elements of the list from *headp as records at
+ * offset `off` of the file of `q`, which is large enough, free them, and
+ * advance *headp past them.
+ * The written pages are dropped from memory; the kernel keeps their
+ * contents in the file.
+ * Return the segment of the records.
+ */
+static spill_seg_t spill_write(queue_t *q,
+                               list_ele_t **headp,
+                               size_t count,
+                               size_t off)
+{
+    struct QSPILL *const sp = q->spill;
+    char *p = sp->map + off;
+
+    for (size_t k = 0; k < count; ++k) {
+        list_ele_t *const x = *headp;
+        const size_t len = x->len + 1;
+        memcpy(p, &len, sizeof(len));
+        memcpy(p + sizeof(len), x->value, len);
+        p += sizeof(len) + len;
+        *headp = x->next;
+        ele_free(q, x);
+    }
+    madvise(sp->map + off, page_round(p - (sp->map + off)), MADV_DONTNEED);
+    return (spill_seg_t){off, p - (sp->map + off), count};
+}
+
+/*
+ * Write the oldest `seg_len` elements of the back list of `q` as the newest
+ * segment, and free them.
+ * Return false, leaving the back list intact, if could not allocate space.
+ */
+static bool spill_out(queue_t *q)
+{
+    struct QSPILL *const sp = q->spill;
+    const size_t off = page_round(sp->end);
+    size_t bytes = 0;
+
+    if (sp->nsegs == sp->cap) {
+        const size_t cap = (sp->cap) ? 2 * sp->cap : 16;
+        spill_seg_t *const segs = malloc(cap * sizeof(spill_seg_t));
+        if (!segs)
+            return false;
+        for (size_t i = 0; i < sp->nsegs; ++i)
+            segs[i] = sp->segs[(sp->first + i) % sp->cap];
+        free(sp->segs);
+        sp->segs = segs;
+        sp->first = 0;
+        sp->cap = cap;
+    }
+
+    list_ele_t *e = sp->back;
+    for (size_t k = 0; k < sp->seg_len; ++k, e = e->next)
+        bytes += sizeof(size_t) + e->len + 1;
+    if (!spill_grow(sp, off + bytes))
+        return false;
+
+    sp->segs[(sp->first + sp->nsegs++) % sp->cap] =
+        spill_write(q, &sp->back, sp->seg_len, off);
+    sp->end = off + bytes;
+    sp->back_len -= sp->seg_len;
+    sp->spilled += sp->seg_len;
+    skip_invalidate(q);
+    seg_invalidate(q);
+    compact_restart(q);
+    sorted_reset(q);
+    return true;
+}
+
+/*
+ * Allocate the elements of the segment `seg` of `q` into `span`.
+ * Return false, with no effect, if could not allocate space.
+ */
+static bool spill_load(const queue_t *q,
+                       const spill_seg_t *seg,
+                       list_span_t *span)
+{
+    const struct QSPILL *const sp = q->spill;
+    list_ele_t dummy;
+    list_ele_t *tail = &dummy;
+    const char *p = sp->map + seg->off;
+
+    for (size_t k = 0; k < seg->count; ++k) {
+        size_t len;
+        memcpy(&len, p, sizeof(len));
+        list_ele_t *const e = ele_alloc(q->alloc, p + sizeof(len), len - 1);
+        if (!e) {
+            tail->next = NULL;
+            for (list_ele_t *x = dummy.next; x;) {
+                list_ele_t *const next = x->next;
+                ele_free(q, x);
+                x = next;
+            }
+            return false;
+        }
+        tail->next = e;
+        tail = e;
+        p += sizeof(len) + len;
+    }
+    tail->next = NULL;
+    seg_drop(sp, seg);
+    span->head = dummy.next;
+    span->tail = tail;
+    return true;
+}
+
+/* Drop the oldest segment of `sp`, reusing the file once none is left */
+static void spill_pop(struct QSPILL *sp)
+{
+    sp->spilled -= sp->segs[sp->first].count;
+    sp->first = (sp->first + 1) % sp->cap;
+    if (!--sp->nsegs)
+        sp->end = 0;
+}
+
+/*
+ * Refill the empty front list of `q` with the oldest segment, or with the
+ * back list if there is none.
+ * The front list stays empty if could not allocate space.
+ */
+static void spill_refill(queue_t *q)
+{
+    struct QSPILL *const sp = q->spill;
+    list_span_t span;
+
+    if (sp->nsegs) {
+        if (!spill_load(q, &sp->segs[sp->first], &span))
+            return;
+        spill_pop(sp);
+        q->head = span.head;
+        if (!sp->back)
+            q->tail = span.tail;
+    } else if (sp->back) {
+        q->head = sp->back;
+        sp->back = NULL;
+        sp->back_len = 0;
+    }
+}
+
+/*
+ * Append `newh` to the back list of `q` once the front list holds a
+ * segment, and spill the oldest segment of the back list once it has more.
+ * Return false if `newh` is to be appended to the front list instead.
+ * Note: `q->size` does not count `newh` yet.
+ */
+static bool spill_append(queue_t *q, list_ele_t *newh)
+{
+    struct QSPILL *const sp = q->spill;
+
+    if (sp->back) {
+        q->tail->next = newh;
+    } else {
+        if (!sp->nsegs && q->size < sp->seg_len)
+            return false;
+        sp->back = newh;
+    }
+    q->tail = newh;
+    /* On failure, the elements stay in memory until the next attempt */
+    if (++sp->back_len > sp->seg_len)
+        spill_out(q);
+    return true;
+}
+
+/*
+ * Attempt to insert the `len` bytes of `s` at head of `q`, which is not
+ * NULL.
+ * Return `Q_OK` if successful.
+ * Return `Q_FULL` if `q` is bounded and full.
+ * Return `Q_FAIL` if could not allocate space.
+ */
+static q_status_t insert_head(queue_t *q, const char *s, size_t len)
+{
+    list_ele_t *newh;
+    if (q_full(q))
+        return Q_FULL;
+
+    newh = ele_new(q, s, len);
+    if (newh) {
+        skip_invalidate(q);
+        newh->next = q->head;
+        q->head = newh;
+        if (!q->tail)  // The tail will appear
+            q->tail = newh;
+        /* The new head extends the sorted prefix, or starts a new one */
+        if (q->sorted_len && ele_cmp(newh, newh->next, q->sorted_cmp) <= 0) {
+            ++q->sorted_len;
+        } else if (q->sorted_cmp) {
+            q->sorted_len = 1;
+            q->sorted_tail = newh;
+        }
+        seg_insert_head(q, newh);
+        ++q->size;
+        return Q_OK;
+    }
+    return Q_FAIL;
+}
+
+/*
+ * Attempt to insert the `len` bytes of `s` at tail of `q`, which is not
+ * NULL.
+ * Return `Q_OK` if successful.
+ * Return `Q_FULL` if `q` is bounded and full, unless it is set to overwrite,
+ * in which case the head is dropped to make room.
+ * Return `Q_FAIL` if could not allocate space.
+ */
+static q_status_t insert_tail(queue_t *q, const char *s, size_t len)
+{
+    list_ele_t *newh;
+    if (q_full(q)) {
+        if (!q->pool->overwrite)
+            return Q_FULL;
+        q_remove_head(q, NULL, 0);
+    }
+
+    newh = ele_new(q, s, len);
+    if (newh) {
+        skip_invalidate(q);
+        newh->next = NULL;
+        if (!q->spill || !spill_append(q, newh)) {
+            if (!q->head)  // The head will appear
+                q->head = newh;
+            else if (q->tail)  // The original tail will be appended
+                q->tail->next = newh;
+            q->tail = newh;
+        }
+        /* The new tail extends a sorted prefix covering the whole queue */
+        if (q->sorted_len && q->sorted_len == q->size &&
+            ele_cmp(q->sorted_tail, newh, q->sorted_cmp) <= 0) {
+            ++q->sorted_len;
+            q->sorted_tail = newh;
+        }
+        seg_insert_tail(q, newh);
+        ++q->size;
+        return Q_OK;
+    }
+    return Q_FAIL;
+}
+
+/*
+ * Attempt to insert element at head of queue.
+ * Return `Q_OK` if successful.
+ * Return `Q_FULL` if `q` is bounded and full.
+ * Return `Q_FAIL` if `q` is NULL or could not allocate space.
+ */
+q_status_t q_try_insert_head(queue_t *q, char *s)
+{
+    return (q) ? insert_head(q, s, strlen(s)) : Q_FAIL;
+}
+
+/*
+ * Attempt to insert element at tail of queue.
+ * Return `Q_OK` if successful.
+ * Return `Q_FULL` if `q` is bounded and full, unless it is set to overwrite,
+ * in which case the head is dropped to make room.
+ * Return `Q_FAIL` if `q` is NULL or could not allocate space.
+ */
+q_status_t q_try_insert_tail(queue_t *q, char *s)
+{
+    return (q) ? insert_tail(q, s, strlen(s)) : Q_FAIL;
+}
+
+/*
+ * Attempt to insert element at head of queue.
+ * Return true if successful.
+ * Return false if q is NULL or could not allocate space.
+ * Argument s points to the string to be stored.
+ * The function must explicitly allocate space and copy the string into it.
+ */
+bool q_insert_head(queue_t *q, char *s)
+{
+    return q_try_insert_head(q, s) == Q_OK;
+}
+
+/*
+ * Attempt to insert element at tail of queue.
+ * Return true if successful.
+ * Return false if q is NULL or could not allocate space.
+ * Argument s points to the string to be stored.
+ * The function must explicitly allocate space and copy the string into it.
+ */
+bool q_insert_tail(queue_t *q, char *s)
+{
+    return q_try_insert_tail(q, s) == Q_OK;
+}
+
+/* Insert the `len` bytes at `p` at head of `q` */
+bool q_insert_head_bytes(queue_t *q, const void *p, size_t len)
+{
+    if (!q || (!p && len))
+        return false;
+    return insert_head(q, (p) ? p : "", len) == Q_OK;
+}
+
+/* Insert the `len` bytes at `p` at tail of `q` */
+bool q_insert_tail_bytes(queue_t *q, const void *p, size_t len)
+{
+    if (!q || (!p && len))
+        return false;
+    return insert_tail(q, (p) ? p : "", len) == Q_OK;
+}
+
+/*
+ * Attempt to remove element from head of queue.
+ * Return true if successful.
+ * Return false if queue is NULL or empty.
+ * If sp is non-NULL and an element is removed, copy the removed string to *sp
+ * (up to a maximum of bufsize-1 characters, plus a null terminator.)
+ * The space used by the list element and the string should be freed.
+ */
+bool q_remove_head(queue_t *q, char *sp, size_t bufsize)
+{
+    size_t len;
+
+    if (!q_remove_head_bytes(q, sp, (bufsize) ? bufsize - 1 : 0, &len))
+        return false;
+    if (sp && bufsize)
+        sp[(len < bufsize - 1) ? len : bufsize - 1] = '\0';
+    return true;
+}
+
+/*
+ * Return the head of `q`, reading spilled elements back if the front is
+ * empty, or NULL if `q` is NULL or empty
+ */
+static list_ele_t *head_load(queue_t *q)
+{
+    if (!q)
+        return NULL;
+    if (!q->head && q->spill)
+        spill_refill(q);
+    return q->head;
+}
+
+/*
+ * Remove the head of `q`, copying at most `bufsize` bytes of its value to
+ * `buf` and its length to *lenp
+ */
+bool q_remove_head_bytes(queue_t *q, void *buf, size_t bufsize, size_t *lenp)
+{
+    list_ele_t *const node = head_load(q);
+
+    if (!node)
+        return false;
+    if (buf && bufsize)
+        memcpy(buf, node->value, (node->len < bufsize) ? node->len : bufsize);
+    if (lenp)
+        *lenp = node->len;
+
+    /* The tower of the head is the first one of each of its levels */
+    if (q->skip && q->skip->valid && q->skip->first[0] &&
+        q->skip->first[0]->ele == node) {
+        struct SKIPIDX *const idx = q->skip;
+        skip_node_t *const tower = idx->first[0];
+        for (int l = 0; l < tower->height; ++l)
+            idx->first[l] = tower->next[l];
+        while (idx->level > 0 && !idx->first[idx->level - 1])
+            --idx->level;
+        free(tower);
+    }
+
+    seg_remove_head(q);
+    if (q->compact && q->compact->last == node)
+        q->compact->last = NULL;
+    q->head = q->head->next;
+    if (node == q->tail)  // The tail will disappear
+        q->tail = NULL;
+    if (q->sorted_len && !--q->sorted_len)
+        q->sorted_tail = NULL;
+    ele_delete(q, node);
+
+    --q->size;
+    if (!q->head && q->spill)
+        spill_refill(q);
+    return true;
+}
+
+/* Return the value of the head of `q`, setting *lenp to its length */
+const void *q_peek_head_bytes(queue_t *q, size_t *lenp)
+{
+    const list_ele_t *const node = head_load(q);
+
+    if (!node)
+        return NULL;
+    if (lenp)
+        *lenp = node->len;
+    return node->value;
+}
+
+/*
+ * Return number of elements in queue.
+ * Return 0 if q is NULL or empty
+ */
+int q_size(queue_t *q)
+{
+    const size_t size = q_size64(q);
+    return (size > INT_MAX) ? INT_MAX : (int) size;
+}
+
+/*
+ * Return number of elements in queue, however many.
+ * Return 0 if q is NULL or empty
+ */
+size_t q_size64(queue_t *q)
+{
+    return (q) ? q->size : 0;
+}
+
+/*
+ * Reverse elements in queue
+ * No effect if q is NULL or empty
+ * This function should not allocate or free any list elements
+ * (e.g., by calling q_insert_head, q_insert_tail, or q_remove_head).
+ * It should rearrange the existing ones.
+ */
+void q_reverse(queue_t *q)
+{
+    list_ele_t *starts[CHAIN_WAYS];
+    size_t ways;
+
+    if (!q || !q_unspill(q) || !q->head)
+        return;
+
+    /* Split the list while the indexes still match it */
+    ways = chain_split(q, starts);
+    skip_invalidate(q);
+    seg_invalidate(q);
+    compact_restart(q);
+    sorted_reset(q);
+
+    chain_reverse(q, starts, ways);
+}
+
+/*
+ * Sort `len` elements start with `head` in ascending order using merge sort
+ * No effect if `head` is `NULL` or its member `next` is `NULL`.
+ * The function reduces to insertion sort when `len` < 4
+ */
+static list_span_t ele_sort(list_ele_t *head, size_t len, cmp_func_t cmp)
+{
+    list_ele_t *left;
+    list_ele_t *right;
+    list_ele_t *merge;
+
+    if (!head || !head->next)
+        return (list_span_t){head, head};
+
+    left = right = head;
+    for (size_t k = 1, n = len / 2; k < n && right; ++k)
+        right = right->next;
+    if (right) {
+        list_ele_t *const next = right->next;
+        right->next = NULL;
+        right = next;
+    }
+
+    {
+        const list_span_t left_res = ele_sort(left, len / 2, cmp);
+        left = left_res.head;
+        if (!right)  // `left` is the head of the sorted list
+            return left_res;
+    }
+    right = ele_sort(right, len / 2 + len % 2, cmp).head;
+
+    /* Now `left` and `right` are both the head of a non-`NULL` sorted list */
+    {
+        /* Set up the beginning of the merged list */
+        list_ele_t **const phead =
+            (ele_cmp(left, right, cmp) < 0) ? &left : &right;
+        merge = head = *phead;
+        *phead = (*phead)->next;
+    }
+
+    while (left || right) {
+        if (!right || (left && ele_cmp(left, right, cmp) < 0)) {
+            /* `left` should be linked from `merge` */
+            merge->next = left;
+            left = left->next;
+        } else {
+            /* `right` should be linked from `merge` */
+            merge->next = right;
+            right = right->next;
+        }
+        merge = merge->next;
+    }
+
+    return (list_span_t){head, merge};
+}
+
+/*
+ * Merge the sorted lists `a` and `b` into one, taking elements of `a` first
+ * among equal ones.
+ * The rest of a list is linked at once when the other one runs out, so that
+ * merging a short list into a long one stops after its last element.
+ */
+static list_span_t ele_merge(list_span_t a, list_span_t b, cmp_func_t cmp)
+{
+    list_ele_t dummy;
+    list_ele_t *tail = &dummy;
+    list_ele_t *x = a.head;
+    list_ele_t *y = b.head;
+
+    while (x && y) {
+        if (ele_cmp(y, x, cmp) < 0) {
+            tail->next = y;
+            tail = y;
+            y = y->next;
+        } else {
+            tail->next = x;
+            tail = x;
+            x = x->next;
+        }
+    }
+    tail->next = (x) ? x : y;
+    if (x)
+        tail = a.tail;
+    else if (y)
+        tail = b.tail;
+    return (list_span_t){dummy.next, tail};
+}
+
+/* Sorting by key prefixes */
+
+/*
+ * Return the key of the value of `e` at offset `off`: its next 8 bytes as a
+ * big-endian integer, folded to lower case if `fold` is set and negated if
+ * `neg` is set, with the sign bit flipped so that keys compare as signed
+ * integers.
+ * Values ending before are padded with zero bytes.  Folded values end at
+ * their first zero byte, as strcasecmp() sees them.
+ */
+static int64_t key_prefix(const list_ele_t *e, size_t off, bool fold, bool neg)
+{
+    const unsigned char *const s = (const unsigned char *) e->value + off;
+    size_t n = (e->len < off) ? 0 : e->len - off;
+    uint64_t key = 0;
+
+    for (size_t i = 0; i < 8; ++i) {
+        const unsigned char c = (i < n) ? s[i] : '\0';
+        if (fold && !c)
+            n = i;
+        key = key << 8 | (unsigned char) ((fold) ? tolower(c) : c);
+    }
+    if (neg)
+        key = ~key;
+    return (int64_t) (key ^ (1ULL << 63));
+}
+
+/*
+ * Whether the value of `e` goes on past the 8 bytes at offset `off`, which
+ * were in its key.  Folded values end at their first zero byte.
+ */
+static bool key_more(const list_ele_t *e, size_t off, bool fold)
+{
+    return e->len > off + 8 && !(fold && memchr(e->value + off, '\0', 8));
+}
+
+/*
+ * Order the runs of equal keys among the `len` sorted entries by the next 8
+ * bytes of their values, which start at offset `off`, and so on until the
+ * keys differ or hold the ends of the values, and then by length unless
+ * folded.
+ * This is the order of the comparator the keys were made for, without
+ * calling it.  Lengths only differ among values holding zero bytes.
+ */
+static void key_ties(int64_t *keys,
+                     void **vals,
+                     int64_t *tmp_keys,
+                     void **tmp_vals,
+                     size_t len,
+                     size_t off,
+                     bool fold,
+                     bool neg)
+{
+    for (size_t i = 0; i < len;) {
+        bool more = false, uneven = false;
+        size_t j = i + 1;
+        while (j < len && keys[j] == keys[i])
+            ++j;
+        for (size_t k = i; k < j && j - i > 1; ++k) {
+            const list_ele_t *const e = vals[k];
+            more = more || key_more(e, off, fold);
+            uneven = uneven || e->len != ((list_ele_t *) vals[i])->len;
+        }
+
+        if (more) {
+            for (size_t k = i; k < j; ++k)
+                keys[k] = key_prefix(vals[k], off + 8, fold, neg);
+            keysort(keys + i, vals + i, j - i, tmp_keys + i, tmp_vals + i);
+            key_ties(keys + i, vals + i, tmp_keys + i, tmp_vals + i, j - i,
+                     off + 8, fold, neg);
+        } else if (uneven && !fold) {
+            /* The keys hold the whole values, padded alike */
+            for (size_t k = i; k < j; ++k) {
+                const int64_t n = ((list_ele_t *) vals[k])->len;
+                keys[k] = (neg) ? -n : n;
+            }
+            keysort(keys + i, vals + i, j - i, tmp_keys + i, tmp_vals + i);
+        }
+        i = j;
+    }
+}
+
+/*
+ * Sort `len` elements starting with `head` by their key prefixes, if `cmp`
+ * orders strings by their bytes, and return the sorted list in `span`.
+ * The keys and element pointers live in the scratch space of `q`.
+ * Return false, with no effect, if `cmp` is not one of those comparators,
+ * or the scratch space is too small.
+ */
+static bool ele_keysort(queue_t *q,
+                        list_ele_t *head,
+                        size_t len,
+                        cmp_func_t cmp,
+                        list_span_t *span)
+{
+    const bool fold = cmp == strcasecmp || cmp == negstrcasecmp;
+    const bool neg = cmp == negstrcasecmp || cmp == negstrcmp;
+
+    if (keysort_kernel() == KEYSORT_OFF || (!fold && !neg && cmp != strcmp) ||
+        len > q->scratch_size / (2 * (sizeof(int64_t) + sizeof(void *))))
+        return false;
+
+    int64_t *const keys = q->scratch;
+    int64_t *const tmp_keys = keys + len;
+    void **const vals = (void **) (tmp_keys + len);
+    void **const tmp_vals = vals + len;
+
+    list_ele_t *e = head;
+    for (size_t i = 0; i < len; ++i, e = e->next) {
+        keys[i] = key_prefix(e, 0, fold, neg);
+        vals[i] = e;
+    }
+    keysort(keys, vals, len, tmp_keys, tmp_vals);
+    key_ties(keys, vals, tmp_keys, tmp_vals, len, 0, fold, neg);
+
+    for (size_t i = 0; i + 1 < len; ++i)
+        ((list_ele_t *) vals[i])->next = vals[i + 1];
+    ((list_ele_t *) vals[len - 1])->next = NULL;
+    span->head = vals[0];
+    span->tail = vals[len - 1];
+    return true;
+}
+
+/*
+ * Sort `len` elements starting with `head` by their key prefixes if
+ * possible, or by merge sort of the list otherwise
+ */
+static list_span_t ele_sort_any(queue_t *q,
+                                list_ele_t *head,
+                                size_t len,
+                                cmp_func_t cmp)
+{
+    list_span_t span;
+    if (!ele_keysort(q, head, len, cmp, &span))
+        span = ele_sort(head, len, cmp);
+    return span;
+}
+
+/* External sort */
+
+/* The size of blocks written to run files */
+#define EXT_BLOCK (1 << 20)
+
+/*
+ * Buffered writer of runs.
+ * A record holds the element pointer, the size of the value including its
+ * terminator, and the value itself.
+ */
+typedef struct {
+    int fd;     /* The file of runs */
+    off_t end;  /* The number of bytes written to the file */
+    char *buf;  /* Block of EXT_BLOCK bytes */
+    size_t len; /* The number of bytes pending in `buf` */
+} run_writer_t;
+
+/*
+ * Cursor over the records of a run, mapped in memory.  Records of a spilled
+ * queue have no element pointer.
+ */
+typedef struct {
+    bool ptrs;         /* Whether records start with element pointers */
+    const char *pos;   /* The next record */
+    const char *end;   /* The end of the run */
+    list_ele_t *ele;   /* The element of the current record */
+    const char *value; /* The value of the current record, NULL at the end */
+    size_t len;        /* The length of the value */
+} run_cursor_t;
+
+/* Write the pending block to the end of the file */
+static bool run_flush(run_writer_t *w)
+{
+    for (size_t done = 0; done < w->len;) {
+        const ssize_t n =
+            pwrite(w->fd, w->buf + done, w->len - done, w->end + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += n;
+    }
+    w->end += w->len;
+    w->len = 0;
+    return true;
+}
+
+/* Append `size` bytes from `data`, writing out the block when full */
+static bool run_write(run_writer_t *w, const void *data, size_t size)
+{
+    const char *p = data;
+    while (size) {
+        if (w->len == EXT_BLOCK && !run_flush(w))
+            return false;
+        const size_t room = EXT_BLOCK - w->len;
+        const size_t n = (size < room) ? size : room;
+        memcpy(w->buf + w->len, p, n);
+        w->len += n;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+/* Append the records of the sorted list starting with `head` */
+static bool run_put(run_writer_t *w, list_ele_t *head)
+{
+    for (list_ele_t *e = head; e; e = e->next) {
+        const size_t len = e->len + 1;
+        if (!run_write(w, &e, sizeof(e)) ||
+            !run_write(w, &len, sizeof(len)) || !run_write(w, e->value, len))
+            return false;
+    }
+    return true;
+}
+
+/* Advance to the next record of the run */
+static void run_next(run_cursor_t *c)
+{
+    const char *p = c->pos;
+    size_t len;
+    if (p == c->end) {
+        c->value = NULL;
+        return;
+    }
+    if (c->ptrs) {
+        memcpy(&c->ele, p, sizeof(c->ele));
+        p += sizeof(c->ele);
+    }
+    memcpy(&len, p, sizeof(len));
+    c->value = p + sizeof(len);
+    c->len = len - 1;
+    c->pos = c->value + len;
+}
+
+/* Whether the record of run `i` goes before the one of run `j` */
+static inline bool run_beats(const run_cursor_t *runs,
+                             int i,
+                             int j,
+                             cmp_func_t cmp)
+{
+    if (!runs[j].value)
+        return true;
+    if (!runs[i].value)
+        return false;
+    const int c =
+        value_cmp(runs[i].value, runs[i].len, runs[j].value, runs[j].len, cmp);
+    return c < 0 || (c == 0 && i < j);
+}
+
+/*
+ * Read the first record of each of the `k` runs, and build a loser tree
+ * over them, as in `ele_merge_ways()`.  The run holding the least record
+ * is left in loser[0].
+ */
+static void run_tree_init(run_cursor_t *runs,
+                          int k,
+                          int *loser,
+                          int *winner,
+                          cmp_func_t cmp)
+{
+    for (int i = 0; i < k; ++i) {
+        run_next(&runs[i]);
+        winner[k + i] = i;
+    }
+    for (int t = k - 1; t > 0; --t) {
+        const int a = winner[2 * t], b = winner[2 * t + 1];
+        const bool a_wins = run_beats(runs, a, b, cmp);
+        winner[t] = a_wins ? a : b;
+        loser[t] = a_wins ? b : a;
+    }
+    loser[0] = (k == 1) ? 0 : winner[1];
+}
+
+/* Advance the run in loser[0] past its record, and replay its path */
+static void run_tree_next(run_cursor_t *runs,
+                          int k,
+                          int *loser,
+                          cmp_func_t cmp)
+{
+    int cur = loser[0];
+    run_next(&runs[cur]);
+    for (int t = (k + cur) / 2; t > 0; t /= 2) {
+        if (run_beats(runs, loser[t], cur, cmp)) {
+            const int tmp = loser[t];
+            loser[t] = cur;
+            cur = tmp;
+        }
+    }
+    loser[0] = cur;
+}
+
+/*
+ * Relink the elements of `q` in the order of the `k` runs merged by a loser
+ * tree.
+ * The values compared are the copies in the runs, so that the elements are
+ * only touched once to be linked.
+ */
+static void run_merge(queue_t *q,
+                      run_cursor_t *runs,
+                      int k,
+                      int *loser,
+                      int *winner,
+                      cmp_func_t cmp)
+{
+    list_ele_t dummy;
+    list_ele_t *tail = &dummy;
+
+    run_tree_init(runs, k, loser, winner, cmp);
+    while (runs[loser[0]].value) {
+        tail->next = runs[loser[0]].ele;
+        tail = runs[loser[0]].ele;
+        run_tree_next(runs, k, loser, cmp);
+    }
+    tail->next = NULL;
+    q->head = dummy.next;
+    q->tail = tail;
+}
+
+/*
+ * Sort `q` through a temporary file if its values take more than its sort
+ * budget.
+ * The queue is cut into runs of about the budget, each sorted in memory and
+ * written out in large blocks.  The file is then mapped and the runs are
+ * merged, relinking each element once.
+ * Return false, leaving `q` intact, if the queue fits in the budget or any
+ * step before merging fails.  The runs sorted by then stay in place, with
+ * the sorted prefix forgotten.
+ */
+static bool ext_sort(queue_t *q, cmp_func_t cmp)
+{
+    list_ele_t done = {.next = NULL};
+    list_ele_t *done_tail = &done;
+    list_ele_t *rest = q->head;
+    run_writer_t w = {.fd = -1, .end = 0, .buf = NULL, .len = 0};
+    off_t *ends = NULL;
+    size_t nruns = 0, cap = 0;
+    FILE *file = NULL;
+    void *map = MAP_FAILED;
+    run_cursor_t *runs = NULL;
+    bool ok = false;
+
+    while (rest) {
+        /* Cut a run of at least the budget, or the rest of the queue */
+        size_t bytes = 0, len = 0;
+        list_ele_t *e = rest, *last;
+        do {
+            bytes += sizeof(list_ele_t) + e->len + 1;
+            ++len;
+            last = e;
+            e = e->next;
+        } while (e && bytes < q->sort_budget);
+
+        if (!file) {
+            if (!e)
+                return false;
+            file = tmpfile();
+            w.buf = malloc(EXT_BLOCK);
+            if (!file || !w.buf)
+                goto out;
+            w.fd = fileno(file);
+        }
+        if (nruns == cap) {
+            off_t *const grown = malloc((cap ? 2 * cap : 16) * sizeof(off_t));
+            if (!grown)
+                goto out;
+            if (ends)
+                memcpy(grown, ends, cap * sizeof(off_t));
+            free(ends);
+            ends = grown;
+            cap = cap ? 2 * cap : 16;
+        }
+
+        /* Keep the sorted run linked, so that the queue stays intact */
+        last->next = NULL;
+        const list_span_t span = ele_sort(rest, len, cmp);
+        done_tail->next = span.head;
+        done_tail = span.tail;
+        rest = e;
+        if (!run_put(&w, span.head))
+            goto out;
+        ends[nruns++] = w.end + w.len;
+    }
+    if (!run_flush(&w) || nruns > INT_MAX / 2)
+        goto out;
+
+    map = mmap(NULL, w.end, PROT_READ, MAP_SHARED, w.fd, 0);
+    runs = malloc(nruns * (sizeof(run_cursor_t) + 3 * sizeof(int)));
+    if (map == MAP_FAILED || !runs)
+        goto out;
+    madvise(map, w.end, MADV_SEQUENTIAL);
+
+    for (size_t i = 0; i < nruns; ++i) {
+        runs[i].ptrs = true;
+        runs[i].pos = (const char *) map + (i ? ends[i - 1] : 0);
+        runs[i].end = (const char *) map + ends[i];
+    }
+    int *const loser = (int *) (runs + nruns);
+    run_merge(q, runs, nruns, loser, loser + nruns, cmp);
+    ok = true;
+
+out:
+    if (!ok && done_tail != &done) {
+        /* The sorted runs broke the order the prefix and the tail kept */
+        done_tail->next = rest;
+        q->head = done.next;
+        if (!rest)
+            q->tail = done_tail;
+        sorted_reset(q);
+    }
+    if (map != MAP_FAILED)
+        munmap(map, w.end);
+    if (file)
+        fclose(file);
+    free(runs);
+    free(ends);
+    free(w.buf);
+    return ok;
+}
+
+/* Sorting spilled queues */
+
+/* Compare the values of the records at `a` and `b` */
+static inline int rec_cmp(const char *a, const char *b, cmp_func_t cmp)
+{
+    size_t alen, blen;
+    memcpy(&alen, a, sizeof(alen));
+    memcpy(&blen, b, sizeof(blen));
+    return value_cmp(a + sizeof(alen), alen - 1, b + sizeof(blen), blen - 1,
+                     cmp);
+}
+
+/* Sort the `n` records at `recs` stably, with `tmp` as room for as many */
+static void rec_sort(const char **recs,
+                     const char **tmp,
+                     size_t n,
+                     cmp_func_t cmp)
+{
+    const char **from = recs, **to = tmp;
+
+    for (size_t w = 1; w < n; w *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * w) {
+            const size_t mid = (lo + w < n) ? lo + w : n;
+            const size_t hi = (lo + 2 * w < n) ? lo + 2 * w : n;
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+                to[k++] = (rec_cmp(from[j], from[i], cmp) < 0) ? from[j++]
+                                                                : from[i++];
+            while (i < mid)
+                to[k++] = from[i++];
+            while (j < hi)
+                to[k++] = from[j++];
+        }
+        const char **const swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != recs)
+        memcpy(recs, from, n * sizeof(*recs));
+}
+
+/*
+ * Sort the `n` records at `recs`, copy them in order at offset `off` of the
+ * file of `sp`, and point `run` at the copies.
+ * Return the offset past the copies, aligned to a page.
+ */
+static size_t rec_run(struct QSPILL *sp,
+                      const char **recs,
+                      size_t n,
+                      size_t off,
+                      run_cursor_t *run,
+                      cmp_func_t cmp)
+{
+    char *p = sp->map + off;
+
+    rec_sort(recs, recs + n, n, cmp);
+    for (size_t k = 0; k < n; ++k) {
+        size_t len;
+        memcpy(&len, recs[k], sizeof(len));
+        memcpy(p, recs[k], sizeof(len) + len);
+        p += sizeof(len) + len;
+    }
+    madvise(sp->map + off, page_round(p - (sp->map + off)), MADV_DONTNEED);
+    run->ptrs = false;
+    run->pos = sp->map + off;
+    run->end = p;
+    return page_round(p - sp->map);
+}
+
+/*
+ * Return the `i`-th segment of the input of `spill_sort()`: the front list
+ * in lists[0], the segments of `sp`, then the back list in lists[1]
+ */
+static const spill_seg_t *sort_input(const struct QSPILL *sp,
+                                     const spill_seg_t *lists,
+                                     size_t i)
+{
+    if (!i)
+        return &lists[0];
+    if (i <= sp->nsegs)
+        return &sp->segs[(sp->first + i - 1) % sp->cap];
+    return &lists[1];
+}
+
+/*
+ * Drop the pages of the file of `sp` from offset *from, which is aligned to
+ * a page, up to the page of offset `to`, and advance *from past them.
+ * The file keeps their contents.
+ */
+static void spill_drop(const struct QSPILL *sp, size_t *from, size_t to)
+{
+    const size_t page = sysconf(_SC_PAGESIZE);
+    to = to / page * page;
+    if (to > *from) {
+        madvise(sp->map + *from, to - *from, MADV_DONTNEED);
+        *from = to;
+    }
+}
+
+/*
+ * Sort the spilled queue `q` in its file: write its lists out as segments,
+ * sort batches of the records into runs after them, and merge the runs
+ * into new segments, so that neither the elements nor more than about the
+ * sort budget are held in memory.
+ * Memory is reserved and the file grown for the worst case up front, so
+ * that nothing can fail once the lists are written.
+ * Return false, with no effect, if `q` has no segment, if its values fit
+ * the budget, or if could not allocate space.
+ */
+static bool spill_sort(queue_t *q, cmp_func_t cmp)
+{
+    struct QSPILL *const sp = q->spill;
+    /* Budgets below a few hundred bytes would leave no room for a batch */
+    const size_t half = (q->sort_budget > 512) ? q->sort_budget / 2 : 256;
+    const size_t front_len = q->size - sp->spilled - sp->back_len;
+    size_t front = 0, back = 0, total = 0;
+
+    if (!sp->nsegs)
+        return false;
+    for (const list_ele_t *e = q->head; e; e = e->next)
+        front += sizeof(size_t) + e->len + 1;
+    for (const list_ele_t *e = sp->back; e; e = e->next)
+        back += sizeof(size_t) + e->len + 1;
+    total = front + back;
+    for (size_t i = 0; i < sp->nsegs; ++i)
+        total += sp->segs[(sp->first + i) % sp->cap].bytes;
+    if (total <= q->sort_budget)
+        return false;
+
+    /*
+     * A batch ends at `batch` records, or once it holds half the budget.
+     * The cursors over the runs, and a larger ring for the sorted segments
+     * if needed, take the other half, unless the budget is too small for
+     * them; sorting in memory would still take more.
+     */
+    const size_t most = half / (2 * sizeof(char *));
+    const size_t batch = (q->size < most) ? q->size : most;
+    const size_t nruns = q->size / batch + total / half + 1;
+    const size_t nout = (q->size + sp->seg_len - 1) / sp->seg_len;
+    const size_t cap = (nout > sp->cap) ? nout : sp->cap;
+    if (nruns > INT_MAX / 2)
+        return false;
+
+    /* The lists and the runs go after the segments, the output before */
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const size_t base = page_round(sp->end);
+    const size_t runs_base = base + page_round(front) + page_round(back);
+    const size_t run_room = total + nruns * page;
+    const size_t out_room = total + nout * page;
+    const size_t out_base = (runs_base >= out_room) ? 0 : runs_base + run_room;
+    const size_t room = (out_base) ? out_base + out_room : runs_base + run_room;
+    if (!spill_grow(sp, room))
+        return false;
+
+    const char **const recs = malloc(2 * batch * sizeof(char *));
+    run_cursor_t *const runs =
+        malloc(nruns * (sizeof(run_cursor_t) + 3 * sizeof(int)));
+    spill_seg_t *const segs =
+        (cap > sp->cap) ? malloc(cap * sizeof(spill_seg_t)) : sp->segs;
+    if (!recs || !runs || !segs) {
+        free(recs);
+        free(runs);
+        if (segs != sp->segs)
+            free(segs);
+        return false;
+    }
+
+    /* The input is the front list, the segments, then the back list */
+    spill_seg_t lists[2] = {{0, 0, 0}, {0, 0, 0}};
+    if (front_len)
+        lists[0] = spill_write(q, &q->head, front_len, base);
+    if (sp->back_len)
+        lists[1] = spill_write(q, &sp->back, sp->back_len,
+                               base + page_round(front));
+    q->head = q->tail = NULL;
+    sp->back_len = 0;
+
+    /*
+     * Sort the input by batches into runs.  Sorting a batch reads all of
+     * it back, so its pages are dropped once it is written.
+     */
+    int k = 0;
+    size_t n = 0, bytes = 0, off = runs_base, pend = 0;
+    for (size_t i = 0; i < sp->nsegs + 2; ++i) {
+        const spill_seg_t *const seg = sort_input(sp, lists, i);
+        const char *p = sp->map + seg->off;
+        size_t drop = seg->off;
+        for (size_t j = 0; j < seg->count; ++j) {
+            size_t len;
+            memcpy(&len, p, sizeof(len));
+            recs[n++] = p;
+            bytes += sizeof(len) + len;
+            p += sizeof(len) + len;
+            if (n < batch && bytes < half)
+                continue;
+            off = rec_run(sp, recs, n, off, &runs[k++], cmp);
+            n = bytes = 0;
+            for (; pend < i; ++pend)
+                seg_drop(sp, sort_input(sp, lists, pend));
+            spill_drop(sp, &drop, p - sp->map);
+        }
+    }
+    if (n)
+        rec_run(sp, recs, n, off, &runs[k++], cmp);
+    for (; pend < sp->nsegs + 2; ++pend)
+        seg_drop(sp, sort_input(sp, lists, pend));
+    if (segs != sp->segs) {
+        free(sp->segs);
+        sp->segs = segs;
+        sp->cap = cap;
+    }
+
+    /* Merge the runs into segments of `seg_len` records */
+    int *const loser = (int *) (runs + k);
+    size_t start = out_base, count = 0;
+    sp->first = sp->nsegs = 0;
+    off = out_base;
+    run_tree_init(runs, k, loser, loser + k, cmp);
+    while (runs[loser[0]].value) {
+        const run_cursor_t *const c = &runs[loser[0]];
+        const char *const rec = c->value - sizeof(size_t);
+        const size_t size = sizeof(size_t) + c->len + 1;
+        size_t drop = (rec - sp->map) / page * page;
+        memcpy(sp->map + off, rec, size);
+        off += size;
+        run_tree_next(runs, k, loser, cmp);
+        /* Drop the pages of the run behind its cursor */
+        spill_drop(sp, &drop,
+                   (c->value) ? c->value - sizeof(size_t) - sp->map
+                              : page_round(c->end - sp->map));
+        if (++count < sp->seg_len && runs[loser[0]].value)
+            continue;
+        segs[sp->nsegs++] = (spill_seg_t){start, off - start, count};
+        spill_drop(sp, &start, page_round(off));
+        off = start;
+        count = 0;
+    }
+    sp->end = segs[sp->nsegs - 1].off + segs[sp->nsegs - 1].bytes;
+    sp->spilled = q->size;
+    free(recs);
+    free(runs);
+
+    skip_invalidate(q);
+    seg_invalidate(q);
+    compact_restart(q);
+    sorted_reset(q);
+    spill_refill(q);
+    return true;
+}
+
+/*
+ * Sort elements of queue in ascending order
+ * No effect if `q` is `NULL` or empty. In addition, if `q` has only one
+ * element, do nothing.
+ * Argument `cmp` should not be `NULL`.
+ */
+void q_sort(queue_t *q, cmp_func_t cmp)
+{
+    list_span_t span;
+    if (!q || (q->sorted_cmp == cmp && q->sorted_len == q->size))
+        return;
+    if (q->sort_budget && q->spill && spill_sort(q, cmp))
+        return;
+    if (!q_unspill(q) || !q->head || !q->head->next)
+        return;
+
+    skip_invalidate(q);
+    seg_invalidate(q);
+    compact_restart(q);
+    if (!q->sort_budget || !ext_sort(q, cmp)) {
+        if (q->sorted_cmp == cmp && q->sorted_len) {
+            /* Sort the suffix after the sorted prefix, then merge them */
+            const list_span_t prefix = {q->head, q->sorted_tail};
+            span = ele_sort_any(q, prefix.tail->next,
+                                q->size - q->sorted_len, cmp);
+            prefix.tail->next = NULL;
+            span = ele_merge(prefix, span, cmp);
+        } else {
+            span = ele_sort_any(q, q->head, q->size, cmp);
+        }
+        q->head = span.head;
+        q->tail = span.tail;
+    }
+    q->sorted_cmp = cmp;
+    q->sorted_len = q->size;
+    q->sorted_tail = q->tail;
+}
+
+/*
+ * Set the number of bytes of values above which `q_sort()` goes through a
+ * temporary file
+ */
+void q_set_sort_budget(queue_t *q, size_t bytes)
+{
+    if (q)
+        q->sort_budget = bytes;
+}
+
+/*
+ * Make the scratch space of `q` at least `size` bytes.
+ * Return false if could not allocate space.
+ */
+static bool scratch_reserve(queue_t *q, size_t size)
+{
+    if (q->scratch_size >= size)
+        return true;
+
+    void *const scratch = malloc(size);
+    if (!scratch)
+        return false;
+    free(q->scratch);
+    q->scratch = scratch;
+    q->scratch_size = size;
+    return true;
+}
+
+/* Slot of the bucket table used by grouping */
+typedef struct {
+    list_ele_t *head; /* The first element of the group, NULL if empty */
+    list_ele_t *tail; /* The last element of the group */
+    size_t next;      /* The slot of the group that comes next */
+    uint32_t hash;    /* The hash value of the grouped string */
+} group_slot_t;
+
+/* Return the number of slots of a bucket table for `n` elements */
+static size_t group_capacity(size_t n)
+{
+    size_t capacity = 16;
+
+    /* Keep the load factor at most 1/2 */
+    while (capacity / 2 < n && capacity < SIZE_MAX / 4)
+        capacity *= 2;
+    return capacity;
+}
+
+/*
+ * Make sure that operations needing working space for `n` elements do not
+ * allocate.  Grouping needs the most, with its bucket table.
+ */
+bool q_reserve_scratch(queue_t *q, size_t n)
+{
+    size_t size;
+    if (!q || n > SIZE_MAX / 4 / sizeof(group_slot_t))
+        return false;
+
+    size = group_capacity(n) * sizeof(group_slot_t);
+    if (size < 2 * n * (sizeof(int64_t) + sizeof(void *)))
+        size = 2 * n * (sizeof(int64_t) + sizeof(void *));
+    return scratch_reserve(q, size);
+}
+
+/*
+ * Make sure that sorting `n` elements does not allocate.  Sorting by key
+ * prefixes takes two keys and two pointers per element, more than the heap
+ * of a partial sort.
+ */
+bool q_reserve_sort_scratch(queue_t *q, size_t n)
+{
+    if (!q || n > SIZE_MAX / 2 / (sizeof(int64_t) + sizeof(void *)))
+        return false;
+    return scratch_reserve(q, 2 * n * (sizeof(int64_t) + sizeof(void *)));
+}
+
+/* Restore the max-heap order of `heap[0..n-1]` below position `i` */
+static void heap_sift_down(list_ele_t **heap,
+                           size_t n,
+                           size_t i,
+                           cmp_func_t cmp)
+{
+    list_ele_t *const e = heap[i];
+    for (size_t c; (c = 2 * i + 1) < n; i = c) {
+        if (c + 1 < n && ele_cmp(heap[c + 1], heap[c], cmp) > 0)
+            ++c;
+        if (ele_cmp(heap[c], e, cmp) <= 0)
+            break;
+        heap[i] = heap[c];
+    }
+    heap[i] = e;
+}
+
+/*
+ * Move the `k` smallest elements to the head in ascending order.
+ * Elements are detached from the queue one by one; the `k` smallest seen so
+ * far stay in a max-heap, and the others are appended to the rest list.
+ * Finally the heap is sorted in place and linked before the rest.
+ */
+bool q_sort_topk(queue_t *q, size_t k, cmp_func_t cmp)
+{
+    if (!q || !q_unspill(q))
+        return false;
+    if (k >= q->size) {
+        q_sort(q, cmp);
+        return true;
+    }
+    if (!k || (q->sorted_cmp == cmp && q->sorted_len == q->size))
+        return true;
+    if (!scratch_reserve(q, k * sizeof(list_ele_t *)))
+        return false;
+
+    list_ele_t **const heap = q->scratch;
+    list_ele_t rest = {.next = NULL};
+    list_ele_t *rest_tail = &rest;
+    size_t n = 0;
+
+    skip_invalidate(q);
+    seg_invalidate(q);
+    compact_restart(q);
+    for (list_ele_t *e = q->head; e;) {
+        list_ele_t *const next = e->next;
+        if (n < k) {
+            /* Fill the heap, then order it once */
+            heap[n++] = e;
+            if (n == k) {
+                for (size_t i = k / 2; i-- > 0;)
+                    heap_sift_down(heap, k, i, cmp);
+            }
+        } else {
+            if (ele_cmp(e, heap[0], cmp) < 0) {
+                list_ele_t *const evicted = heap[0];
+                heap[0] = e;
+                heap_sift_down(heap, k, 0, cmp);
+                e = evicted;
+            }
+            rest_tail->next = e;
+            rest_tail = e;
+        }
+        e = next;
+    }
+    rest_tail->next = NULL;
+
+    /* Sort the heap in place, the largest element going to the end first */
+    for (size_t i = k; i-- > 1;) {
+        list_ele_t *const max = heap[0];
+        heap[0] = heap[i];
+        heap[i] = max;
+        heap_sift_down(heap, i, 0, cmp);
+    }
+
+    for (size_t i = 0; i + 1 < k; ++i)
+        heap[i]->next = heap[i + 1];
+    heap[k - 1]->next = rest.next;
+    q->head = heap[0];
+    /* The rest is not empty since `k` < size */
+    q->tail = rest_tail;
+    q->sorted_cmp = cmp;
+    q->sorted_len = k;
+    q->sorted_tail = heap[k - 1];
+    return true;
+}
+
+/*
+ * Make equal strings contiguous.
+ * Each element is appended to the group of its value, found in a bucket
+ * table by linear probing, and the groups are chained in the order of their
+ * first elements.
+ */
+bool q_group(queue_t *q)
+{
+    if (!q || !q_unspill(q))
+        return false;
+    if (!q->head || !q->head->next)
+        return true;
+    if (!q_reserve_scratch(q, q->size))
+        return false;
+
+    group_slot_t *const slots = q->scratch;
+    const size_t mask = group_capacity(q->size) - 1;
+    size_t first = SIZE_MAX, last = SIZE_MAX;
+
+    memset(slots, 0, (mask + 1) * sizeof(group_slot_t));
+    for (list_ele_t *e = q->head; e;) {
+        list_ele_t *const next = e->next;
+        const uint32_t hv = hash_str(e->value);
+        size_t k = hv & mask;
+        while (slots[k].head && (slots[k].hash != hv ||
+                                 strcmp(slots[k].head->value, e->value)))
+            k = (k + 1) & mask;
+
+        if (slots[k].head) {
+            slots[k].tail->next = e;
+        } else {
+            /* A new group goes after all others */
+            slots[k].head = e;
+            slots[k].hash = hv;
+            slots[k].next = SIZE_MAX;
+            if (last == SIZE_MAX)
+                first = k;
+            else
+                slots[last].next = k;
+            last = k;
+        }
+        slots[k].tail = e;
+        e = next;
+    }
+
+    skip_invalidate(q);
+    seg_invalidate(q);
+    compact_restart(q);
+    sorted_reset(q);
+    q->head = slots[first].head;
+    for (size_t k = first; slots[k].next != SIZE_MAX; k = slots[k].next)
+        slots[k].tail->next = slots[slots[k].next].head;
+    q->tail = slots[last].tail;
+    q->tail->next = NULL;
+    return true;
+}
+
+/* The maximum number of lists merged by one loser tree */
+#define MERGE_WAYS 64
+
+/*
+ * Whether the head of list `i` goes before the one of list `j`.
+ * An exhausted list loses to any other, and ties go to the lower index so
+ * that the merge is stable.
+ */
+static inline bool merge_beats(list_ele_t *const *heads,
+                               int i,
+                               int j,
+                               cmp_func_t cmp)
+{
+    if (!heads[j])
+        return true;
+    if (!heads[i])
+        return false;
+    const int c = ele_cmp(heads[i], heads[j], cmp);
+    return c < 0 || (c == 0 && i < j);
+}
+
+/*
+ * Merge `k` sorted lists starting with `heads[0..k-1]` into one using a
+ * loser tree, which takes about log2(k) comparisons per element.
+ * The leaf of list `i` is node `k + i`; `loser[t]` holds the list losing
+ * the match at internal node `t`, and `loser[0]` the overall winner.
+ */
+static list_span_t ele_merge_ways(list_ele_t **heads, int k, cmp_func_t cmp)
+{
+    int loser[MERGE_WAYS], winner[2 * MERGE_WAYS];
+    list_ele_t dummy = {.next = NULL};
+    list_ele_t *tail = &dummy;
+
+    /* Play all matches once from the leaves up */
+    for (int i = 0; i < k; ++i)
+        winner[k + i] = i;
+    for (int t = k - 1; t > 0; --t) {
+        const int a = winner[2 * t], b = winner[2 * t + 1];
+        const bool a_wins = merge_beats(heads, a, b, cmp);
+        winner[t] = a_wins ? a : b;
+        loser[t] = a_wins ? b : a;
+    }
+    loser[0] = winner[1];
+    if (k == 1)
+        loser[0] = 0;
+
+    /* Take the winner, then replay the matches on its path to the root */
+    while (heads[loser[0]]) {
+        int cur = loser[0];
+        tail->next = heads[cur];
+        tail = heads[cur];
+        heads[cur] = heads[cur]->next;
+        for (int t = (k + cur) / 2; t > 0; t /= 2) {
+            if (merge_beats(heads, loser[t], cur, cmp)) {
+                const int tmp = loser[t];
+                loser[t] = cur;
+                cur = tmp;
+            }
+        }
+        loser[0] = cur;
+    }
+    tail->next = NULL;
+
+    return (list_span_t){dummy.next, dummy.next ? tail : NULL};
+}
+
+/*
+ * Merge the elements of `dst` and of queues[0..k-1], each sorted by `cmp`,
+ * into `dst` by relinking them.
+ * Indexed queues are rejected, since moving elements between their indices
+ * would allocate.
+ * Up to MERGE_WAYS - 1 queues join `dst` in each round, so that the tree
+ * lives on the stack.
+ */
+bool q_merge_sorted(queue_t *dst, queue_t *queues[], size_t k, cmp_func_t cmp)
+{
+    list_ele_t *heads[MERGE_WAYS];
+
+    if (!dst || dst->pool || dst->index)
+        return false;
+    for (size_t i = 0; i < k; ++i) {
+        if (queues[i] && queues[i] != dst &&
+            (queues[i]->pool || queues[i]->index ||
+             queues[i]->alloc != dst->alloc))
+            return false;
+    }
+    if (!q_unspill(dst))
+        return false;
+    for (size_t i = 0; i < k; ++i) {
+        if (queues[i] && !q_unspill(queues[i]))
+            return false;
+    }
+
+    skip_invalidate(dst);
+    seg_invalidate(dst);
+    compact_restart(dst);
+    for (size_t i = 0; i < k;) {
+        int ways = 0;
+        heads[ways++] = dst->head;
+        for (; i < k && ways < MERGE_WAYS; ++i) {
+            queue_t *const src = queues[i];
+            if (!src || src == dst || !src->head)
+                continue;
+            heads[ways++] = src->head;
+            dst->size += src->size;
+            src->head = src->tail = NULL;
+            src->size = 0;
+            skip_invalidate(src);
+            seg_invalidate(src);
+            compact_restart(src);
+            sorted_reset(src);
+            sorted_reset(dst);
+        }
+        if (ways == 1)
+            break;
+
+        const list_span_t span = ele_merge_ways(heads, ways, cmp);
+        dst->head = span.head;
+        dst->tail = span.tail;
+    }
+    return true;
+}
+
+/* Return the key of an element for a hash table */
+static const char *ele_key(const void *item)
+{
+    return ((const list_ele_t *) item)->value;
+}
+
+/*
+ * Delete the elements equal to an earlier one.
+ * With `cmp`, the queue is taken as sorted, so that only neighbors need to
+ * be compared.  Without it, a hash table of the kept elements is looked up.
+ */
+bool q_delete_dup(queue_t *q, cmp_func_t cmp)
+{
+    hash_table_t seen;
+    list_ele_t *kept;
+    bool sorted;
+
+    if (!q || !q_unspill(q))
+        return false;
+    if (!q->head)
+        return true;
+
+    /* The table never grows, since it has room for all elements */
+    if (!cmp) {
+        if (!hash_init(&seen, q->size, ele_key))
+            return false;
+        hash_insert(&seen, q->head, hash_str(q->head->value));
     }
-    return q;
-}
 
-/* Free all storage used by queue */
-void q_free(queue_t *q)
-{
-    if (!q)
-        return;
+    /* What is left of a sorted queue stays sorted */
+    sorted = q->sorted_len == q->size;
+    skip_invalidate(q);
+    seg_invalidate(q);
+    compact_restart(q);
+    kept = q->head;
+    for (list_ele_t *e = kept->next; e;) {
+        list_ele_t *const next = e->next;
+        bool dup;
+        if (cmp) {
+            dup = !ele_cmp(kept, e, cmp);
+        } else {
+            const uint32_t hv = hash_str(e->value);
+            dup = hash_find(&seen, e->value, hv);
+            if (!dup)
+                hash_insert(&seen, e, hv);
+        }
 
-    /* Free queue elements */
-    for (list_ele_t *k = q->head; k;) {
-        list_ele_t *const next = k->next;
-        free(k->value);
-        free(k);
-        k = next;
+        if (dup) {
+            ele_delete(q, e);
+            --q->size;
+        } else {
+            kept->next = e;
+            kept = e;
+        }
+        e = next;
     }
-    /* Free queue structure */
-    free(q);
+    kept->next = NULL;
+    q->tail = kept;
+    q->sorted_len = (sorted) ? q->size : 0;
+    q->sorted_tail = (sorted) ? q->tail : NULL;
+
+    if (!cmp)
+        hash_destroy(&seen);
+    return true;
 }
 
 /*
- * Return `NULL` if could not allocate space.
- * Return non-`NULL` if successful.
- * Argument `s` points to the string to be stored and should not be `NULL`.
- * Note: `newh->next` will not be initialized.
+ * Make the index of `q` valid for `cmp`, sorting the queue if needed.
+ * Return false if could not allocate space.
  */
-static list_ele_t *ele_alloc(const char *s)
+static bool skip_prepare(queue_t *q, cmp_func_t cmp)
 {
-    /* Don't forget to allocate space for the string and copy it */
-    list_ele_t *const newh = malloc(sizeof(list_ele_t));
-    if (newh) {
-        const size_t len = strlen(s) + 1;
-        newh->value = malloc(len);
-        if (newh->value) {
-            memcpy(newh->value, s, len);
-        } else {
-            /* What if either call to malloc returns NULL? */
-            free(newh);
-            return NULL;
+    struct SKIPIDX *idx = q->skip;
+    skip_node_t *last[SKIP_MAX_LEVEL] = {NULL};
+    bool sorted = true;
+
+    if (idx && idx->valid && idx->cmp == cmp)
+        return true;
+
+    if (!idx) {
+        idx = malloc(sizeof(struct SKIPIDX));
+        if (!idx)
+            return false;
+        for (int l = 0; l < SKIP_MAX_LEVEL; ++l)
+            idx->first[l] = NULL;
+        idx->level = 0;
+        idx->seed = 2463534242U;
+        q->skip = idx;
+    }
+    idx->valid = false;
+    skip_clear(idx);
+
+    for (list_ele_t *e = q->head; e && e->next && sorted; e = e->next)
+        sorted = ele_cmp(e, e->next, cmp) <= 0;
+    if (!sorted)
+        q_sort(q, cmp);
+
+    /* Build the towers from head to tail */
+    for (list_ele_t *e = q->head; e; e = e->next) {
+        const int h = skip_random_height(idx);
+        skip_node_t *tower;
+        if (!h)
+            continue;
+
+        tower = skip_node_alloc(e, h);
+        if (!tower) {
+            skip_clear(idx);
+            return false;
+        }
+        for (int l = 0; l < h; ++l) {
+            tower->next[l] = NULL;
+            if (last[l])
+                last[l]->next[l] = tower;
+            else
+                idx->first[l] = tower;
+            last[l] = tower;
         }
+        if (h > idx->level)
+            idx->level = h;
     }
-    return newh;
+
+    idx->cmp = cmp;
+    idx->valid = true;
+    return true;
 }
 
 /*
- * Attempt to insert element at head of queue.
+ * Attempt to insert element in ascending order according to `cmp`.
  * Return true if successful.
- * Return false if q is NULL or could not allocate space.
- * Argument s points to the string to be stored.
- * The function must explicitly allocate space and copy the string into it.
+ * Return false if `q` is NULL or could not allocate space.
+ * The queue is sorted first if it is not already sorted by `cmp`.
+ * The element is placed after the elements that compare equal to it.
+ * Successive calls with the same `cmp` take O(log n) expected time.
  */
-bool q_insert_head(queue_t *q, char *s)
+bool q_insert_sorted(queue_t *q, char *s, cmp_func_t cmp)
 {
+    skip_node_t *pred[SKIP_MAX_LEVEL];
+    skip_node_t *tower = NULL;
     list_ele_t *newh;
-    if (!q)
+    list_ele_t *prev;
+    struct SKIPIDX *idx;
+    int h;
+
+    if (!q || q_full(q) || !q_unspill(q) || !skip_prepare(q, cmp))
         return false;
+    idx = q->skip;
 
-    newh = ele_alloc(s);
-    if (newh) {
+    newh = ele_new(q, s, strlen(s));
+    if (!newh)
+        return false;
+    h = skip_random_height(idx);
+    if (h) {
+        tower = skip_node_alloc(newh, h);
+        if (!tower) {
+            ele_delete(q, newh);
+            return false;
+        }
+    }
+
+    /* Link the element after the last one not greater than it */
+    prev = skip_search(q, newh->value, newh->len, true, pred);
+    if (prev) {
+        newh->next = prev->next;
+        prev->next = newh;
+    } else {
         newh->next = q->head;
         q->head = newh;
-        if (!q->tail)  // The tail will appear
-            q->tail = newh;
-        ++q->size;
+    }
+    if (!newh->next)
+        q->tail = newh;
+    ++q->size;
+    seg_invalidate(q);
+    compact_restart(q);
+    q->sorted_cmp = cmp;
+    q->sorted_len = q->size;
+    q->sorted_tail = q->tail;
+
+    /* Link the tower after the last ones preceding it */
+    for (int l = 0; l < h; ++l) {
+        skip_node_t **const link =
+            (l < idx->level && pred[l]) ? &pred[l]->next[l] : &idx->first[l];
+        tower->next[l] = *link;
+        *link = tower;
+    }
+    if (h > idx->level)
+        idx->level = h;
+    return true;
+}
+
+/*
+ * Return the value of the first element which is not less than `s`,
+ * provided that the queue is sorted by `cmp`.
+ * Return NULL if there is no such element or `q` is NULL.
+ * It takes O(log n) expected time after `q_insert_sorted()` with the same
+ * `cmp`, and O(n) time otherwise.
+ */
+const char *q_lower_bound(queue_t *q, const char *s, cmp_func_t cmp)
+{
+    list_ele_t *e;
+    if (!q || !q_unspill(q))
+        return NULL;
+
+    const size_t len = strlen(s);
+    if (q->skip && q->skip->valid && q->skip->cmp == cmp) {
+        list_ele_t *const prev = skip_search(q, s, len, false, NULL);
+        e = (prev) ? prev->next : q->head;
+    } else {
+        e = q->head;
+        while (e && value_cmp(e->value, e->len, s, len, cmp) < 0)
+            e = e->next;
+    }
+    return (e) ? e->value : NULL;
+}
+
+/* The number of values fetched at once by scans using the iterator */
+#define ITER_BATCH 64
+
+/*
+ * Build the hash index of `q` from its elements, or free it.
+ * Return false if could not allocate space, leaving `q` without index.
+ */
+bool q_set_index(queue_t *q, bool on)
+{
+    const char *vals[ITER_BATCH];
+    q_iter_t it;
+    size_t n;
+
+    if (!q)
+        return false;
+    if (!on || q->index) {
+        if (!on && q->index) {
+            index_free(q->index);
+            q->index = NULL;
+        }
         return true;
     }
-    return false;
+
+    struct QINDEX *const idx = malloc(sizeof(struct QINDEX));
+    if (!idx)
+        return false;
+    if (!hash_init(&idx->table, q->size, index_entry_key)) {
+        free(idx);
+        return false;
+    }
+    /* The iterator visits the spilled values too */
+    q_iter_init(&it, q);
+    while ((n = q_iter_next_batch(&it, vals, ITER_BATCH))) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!index_add(idx, vals[i])) {
+                index_free(idx);
+                return false;
+            }
+        }
+    }
+    q->index = idx;
+    return true;
+}
+
+/* Whether `q` has a hash index */
+bool q_has_index(const queue_t *q)
+{
+    return q && q->index;
 }
 
 /*
- * Attempt to insert element at tail of queue.
- * Return true if successful.
- * Return false if q is NULL or could not allocate space.
- * Argument s points to the string to be stored.
- * The function must explicitly allocate space and copy the string into it.
+ * Return the number of elements holding `s`, looking it up in the index if
+ * there is one, or scanning the queue otherwise.
  */
-bool q_insert_tail(queue_t *q, char *s)
+size_t q_count(const queue_t *q, const char *s)
 {
-    list_ele_t *newh;
+    const char *vals[ITER_BATCH];
+    q_iter_t it;
+    size_t cnt = 0, n;
+
+    if (!q)
+        return 0;
+
+    if (q->index) {
+        const index_entry_t *const entry =
+            hash_find(&q->index->table, s, hash_str(s));
+        return entry ? entry->count : 0;
+    }
+
+    q_iter_init(&it, q);
+    while ((n = q_iter_next_batch(&it, vals, ITER_BATCH))) {
+        for (size_t i = 0; i < n; ++i)
+            cnt += !strcmp(vals[i], s);
+    }
+    return cnt;
+}
+
+/* Whether some element of `q` holds `s` */
+bool q_contains(const queue_t *q, const char *s)
+{
+    const char *vals[ITER_BATCH];
+    q_iter_t it;
+    size_t n;
+
     if (!q)
         return false;
+    if (q->index)
+        return q_count(q, s) > 0;
 
-    newh = ele_alloc(s);
-    if (newh) {
-        newh->next = NULL;
-        if (!q->head)  // The head will appear
-            q->head = newh;
-        else if (q->tail)  // The original tail will be appended
-            q->tail->next = newh;
-        q->tail = newh;
-        ++q->size;
-        return true;
+    q_iter_init(&it, q);
+    while ((n = q_iter_next_batch(&it, vals, ITER_BATCH))) {
+        for (size_t i = 0; i < n; ++i) {
+            if (!strcmp(vals[i], s))
+                return true;
+        }
     }
     return false;
 }
 
 /*
- * Attempt to remove element from head of queue.
- * Return true if successful.
- * Return false if queue is NULL or empty.
- * If sp is non-NULL and an element is removed, copy the removed string to *sp
- * (up to a maximum of bufsize-1 characters, plus a null terminator.)
- * The space used by the list element and the string should be freed.
+ * Keep at most about `limit` elements of `q` in memory.
+ * The elements beyond the first segment are moved to the back list, which
+ * is then spilled segment by segment.
  */
-bool q_remove_head(queue_t *q, char *sp, size_t bufsize)
+bool q_set_spill(queue_t *q, size_t limit)
 {
-    list_ele_t *node;
-    if (!q || !q->head)
-        return false;
+    struct QSPILL *sp;
 
-    node = q->head;
-    if (sp && bufsize) {
-        const size_t len = strnlen(node->value, bufsize - 1);
-        memcpy(sp, node->value, len + 1);
-        if (len + 1 == bufsize)
-            sp[len] = '\0';
+    if (!q || q->pool || !q_unspill(q))
+        return false;
+    if (!limit) {
+        if (q->spill) {
+            spill_free(q->spill);
+            q->spill = NULL;
+        }
+        return true;
     }
-    free(node->value);
 
-    q->head = q->head->next;
-    if (node == q->tail)  // The tail will disappear
-        q->tail = NULL;
-    free(node);
+    sp = q->spill;
+    if (!sp) {
+        sp = malloc(sizeof(struct QSPILL));
+        if (!sp)
+            return false;
+        *sp = (struct QSPILL){.file = NULL, .map = NULL, .segs = NULL};
+        q->spill = sp;
+    }
+    sp->seg_len = (limit > 1) ? limit / 2 : 1;
 
-    --q->size;
+    if (q->size > limit) {
+        list_ele_t *cut = q->head;
+        for (size_t k = 1; k < sp->seg_len; ++k)
+            cut = cut->next;
+        sp->back = cut->next;
+        sp->back_len = q->size - sp->seg_len;
+        cut->next = NULL;
+        compact_restart(q);
+        while (sp->back_len > sp->seg_len && spill_out(q))
+            ;
+    }
     return true;
 }
 
 /*
- * Return number of elements in queue.
- * Return 0 if q is NULL or empty
+ * Read the segments of `q` back, and link the front list, the segments and
+ * the back list into one.
+ * All segments are read before any is dropped, so that a failure leaves
+ * `q` as it was.
  */
-int q_size(queue_t *q)
+bool q_unspill(queue_t *q)
 {
-    return (q) ? q->size : 0;
+    struct QSPILL *sp;
+    list_ele_t loaded = {.next = NULL};
+    list_ele_t *tail = &loaded;
+    list_ele_t *front_tail = NULL;
+    list_span_t span;
+
+    if (!q)
+        return false;
+    sp = q->spill;
+    if (!sp || (!sp->nsegs && !sp->back))
+        return true;
+
+    for (size_t i = 0; i < sp->nsegs; ++i) {
+        if (!spill_load(q, &sp->segs[(sp->first + i) % sp->cap], &span)) {
+            for (list_ele_t *x = loaded.next; x;) {
+                list_ele_t *const next = x->next;
+                ele_free(q, x);
+                x = next;
+            }
+            return false;
+        }
+        tail->next = span.head;
+        tail = span.tail;
+    }
+    tail->next = sp->back;
+    if (!sp->back)
+        q->tail = tail;
+
+    for (list_ele_t *e = q->head; e; e = e->next)
+        front_tail = e;
+    if (front_tail)
+        front_tail->next = loaded.next;
+    else
+        q->head = loaded.next;
+
+    sp->back = NULL;
+    sp->back_len = 0;
+    sp->spilled = 0;
+    sp->first = sp->nsegs = sp->end = 0;
+    skip_invalidate(q);
+    return true;
+}
+
+/* Return the number of elements of `q` in segments */
+size_t q_spilled(const queue_t *q)
+{
+    return (q && q->spill) ? q->spill->spilled : 0;
 }
 
 /*
- * Reverse elements in queue
- * No effect if q is NULL or empty
- * This function should not allocate or free any list elements
- * (e.g., by calling q_insert_head, q_insert_tail, or q_remove_head).
- * It should rearrange the existing ones.
+ * Keep a pointer to every `k`-th element of `q`.
+ * The ring of a bounded queue gets room for its capacity up front, so that
+ * its insertion never allocates for the index.
  */
-void q_reverse(queue_t *q)
+bool q_set_segments(queue_t *q, size_t k)
 {
-    list_ele_t *prev;
-
-    if (!q || !q->head)
-        return;
+    struct QSEGIDX *idx;
 
-    /* Re-assign `k->next` */
-    prev = NULL;
-    for (list_ele_t *k = q->head; k;) {
-        list_ele_t *const next = k->next;
-        k->next = prev;
-        prev = k;
-        k = next;
+    if (!q)
+        return false;
+    if (!k) {
+        if (q->seg) {
+            free(q->seg->ring);
+            free(q->seg);
+            q->seg = NULL;
+        }
+        return true;
     }
-    /* `prev` is now the original tail */
 
-    /* Swap `head` and `tail` */
-    q->tail = q->head;
-    q->head = prev;
+    idx = q->seg;
+    if (!idx) {
+        idx = malloc(sizeof(struct QSEGIDX));
+        if (!idx)
+            return false;
+        *idx = (struct QSEGIDX){.ring = NULL};
+        q->seg = idx;
+    }
+    idx->k = k;
+    idx->valid = false;
+    if (q->pool && !seg_reserve(idx, q->pool->capacity / k + 1))
+        return false;
+    /* The elements on disk are indexed once read back by the first use */
+    if (q->spill && (q->spill->nsegs || q->spill->back))
+        return true;
+    return seg_rebuild(q);
 }
 
-typedef struct {
-    list_ele_t *head;
-    list_ele_t *tail;
-} list_span_t;
+/*
+ * Return the value of the element at position `pos` of `q`, counting from
+ * 0 at the head.
+ */
+const char *q_value_at(queue_t *q, size_t pos)
+{
+    if (!q || pos >= q->size || !q_unspill(q))
+        return NULL;
+    return ele_at(q, pos)->value;
+}
 
 /*
- * Sort `len` elements start with `head` in ascending order using merge sort
- * No effect if `head` is `NULL` or its member `next` is `NULL`.
- * The function reduces to insertion sort when `len` < 4
+ * Move the elements of `q` from position `pos` on to the empty queue
+ * `rest`.
+ * The entries of the segment index of `q` past the cut are dropped, and
+ * the one of `rest` is rebuilt on next use.
  */
-static list_span_t ele_sort(list_ele_t *head, size_t len, cmp_func_t cmp)
+bool q_split(queue_t *q, size_t pos, queue_t *rest)
 {
-    list_ele_t *left;
-    list_ele_t *right;
-    list_ele_t *merge;
+    list_ele_t *cut;
 
-    if (!head || !head->next)
-        return (list_span_t){head, head};
+    if (!q || !rest || rest == q || rest->size || q->pool || rest->pool ||
+        q->index || rest->index || q->alloc != rest->alloc || pos > q->size ||
+        !q_unspill(q))
+        return false;
+    if (pos == q->size)
+        return true;
 
-    left = right = head;
-    for (size_t k = 1, n = len / 2; k < n && right; ++k)
-        right = right->next;
-    if (right) {
-        list_ele_t *const next = right->next;
-        right->next = NULL;
-        right = next;
+    cut = (pos) ? ele_at(q, pos - 1) : NULL;
+    rest->head = (cut) ? cut->next : q->head;
+    rest->tail = q->tail;
+    rest->size = q->size - pos;
+    if (cut) {
+        cut->next = NULL;
+        q->tail = cut;
+    } else {
+        q->head = q->tail = NULL;
     }
+    q->size = pos;
 
-    {
-        const list_span_t left_res = ele_sort(left, len / 2, cmp);
-        left = left_res.head;
-        if (!right)  // `left` is the head of the sorted list
-            return left_res;
+    /* The sorted prefix goes on in `rest` if it reaches past the cut */
+    if (q->sorted_len > pos) {
+        rest->sorted_cmp = q->sorted_cmp;
+        rest->sorted_len = q->sorted_len - pos;
+        rest->sorted_tail = q->sorted_tail;
+        q->sorted_len = pos;
+        q->sorted_tail = cut;
+    } else {
+        sorted_reset(rest);
     }
-    right = ele_sort(right, len / 2 + len % 2, cmp).head;
 
-    /* Now `left` and `right` are both the head of a non-`NULL` sorted list */
-    {
-        /* Set up the beginning of the merged list */
-        list_ele_t **const phead =
-            (cmp(left->value, right->value) < 0) ? &left : &right;
-        merge = head = *phead;
-        *phead = (*phead)->next;
+    skip_invalidate(q);
+    skip_invalidate(rest);
+    seg_invalidate(rest);
+    compact_restart(q);
+    compact_restart(rest);
+    if (q->seg && q->seg->valid) {
+        struct QSEGIDX *const idx = q->seg;
+        idx->count = (pos > idx->off) ? (pos - idx->off - 1) / idx->k + 1 : 0;
     }
+    return true;
+}
 
-    while (left || right) {
-        if (!right || (left && cmp(left->value, right->value) < 0)) {
-            /* `left` should be linked from `merge` */
-            merge->next = left;
-            left = left->next;
-        } else {
-            /* `right` should be linked from `merge` */
-            merge->next = right;
-            right = right->next;
-        }
-        merge = merge->next;
+/*
+ * Move up to `max` elements of `q`, going on from the last one moved.
+ * Skip and segment indexes point to the old elements, so they are marked
+ * out of date.
+ */
+size_t q_compact(queue_t *q, size_t max)
+{
+    struct QCOMPACT *cp;
+    list_ele_t *x;
+    size_t moved = 0;
+
+    if (!q || q->pool || q->alloc)
+        return 0;
+    cp = q->compact;
+    if (!cp) {
+        cp = malloc(sizeof(struct QCOMPACT));
+        if (!cp)
+            return 0;
+        *cp = (struct QCOMPACT){.last = NULL, .block = NULL};
+        q->compact = cp;
     }
 
-    return (list_span_t){head, merge};
+    x = (cp->last) ? cp->last->next : q->head;
+    if (x && max) {
+        skip_invalidate(q);
+        seg_invalidate(q);
+    }
+    for (; x && moved < max; ++moved) {
+        list_ele_t *const e = compact_move(q, cp->last, x);
+        if (!e)
+            return moved;
+        cp->last = e;
+        x = e->next;
+    }
+
+    /* The pass is over; the next one starts from the head in a new block */
+    if (!x && moved < max) {
+        cp->last = NULL;
+        compact_release(cp);
+    }
+    return moved;
 }
 
 /*
- * Sort elements of queue in ascending order
- * No effect if `q` is `NULL` or empty. In addition, if `q` has only one
- * element, do nothing.
- * Argument `cmp` should not be `NULL`.
+ * Allocate the elements of `q` from regions of huge pages, or stop.
+ * Return false if q is NULL or bounded, or could not allocate space.
  */
-void q_sort(queue_t *q, cmp_func_t cmp)
+bool q_set_huge_pages(queue_t *q, q_huge_t mode)
 {
-    list_span_t span;
-    if (!q || !q->head || !q->head->next)
+    if (!q || q->pool || q->alloc)
+        return false;
+    if (!q->huge) {
+        if (mode == Q_HUGE_OFF)
+            return true;
+        q->huge = malloc(sizeof(struct QHUGE));
+        if (!q->huge)
+            return false;
+        *q->huge = (struct QHUGE){.mode = Q_HUGE_OFF, .block = NULL};
+    }
+    if (mode == Q_HUGE_OFF)
+        huge_release(q->huge);
+    q->huge->mode = mode;
+    return true;
+}
+
+/* Report the regions of huge pages mapped for `q` */
+void q_huge_stats(const queue_t *q, q_huge_stats_t *stats)
+{
+    *stats = (q && q->huge) ? q->huge->stats : (q_huge_stats_t){0};
+    stats->mode = (q && q->huge) ? q->huge->mode : Q_HUGE_OFF;
+}
+
+/* Report the shape and the upkeep of the segment index of `q` */
+void q_segment_stats(const queue_t *q, q_seg_stats_t *stats)
+{
+    const struct QSEGIDX *const idx = (q) ? q->seg : NULL;
+
+    *stats = (q_seg_stats_t){0};
+    if (!idx)
         return;
+    stats->k = idx->k;
+    stats->entries = (idx->valid) ? idx->count : 0;
+    stats->bytes = sizeof(struct QSEGIDX) + idx->cap * sizeof(list_ele_t *);
+    stats->updates = idx->updates;
+    stats->rebuilds = idx->rebuilds;
+}
+
+/*
+ * Start iterating over the values of queue from its head.
+ * The iteration over a NULL queue is empty.
+ */
+void q_iter_init(q_iter_t *it, const queue_t *q)
+{
+    it->next = (q) ? q->head : NULL;
+    it->spill = (q) ? q->spill : NULL;
+    it->seg = it->dropped = 0;
+    it->pos = it->end = NULL;
+}
+
+/*
+ * Fetch the values of the next (at most `max`) elements into `out`.
+ * Return the number of values fetched; return 0 once all are visited.
+ * The values are not copied. They remain valid until the queue is modified.
+ */
+size_t q_iter_next_batch(q_iter_t *it, const char **out, size_t max)
+{
+    const list_ele_t *e = it->next;
+    size_t n = 0;
+
+    for (;;) {
+        for (; e && n < max; e = e->next) {
+            /* The caller will scan the strings after the batch is filled */
+            __builtin_prefetch(e->value);
+            out[n++] = e->value;
+        }
+        if (e || n == max || !it->spill)
+            break;
+
+        /* The front list is done; read the segments in place */
+        const struct QSPILL *const sp = it->spill;
+        /* The caller is done with the segments before the current one */
+        for (; it->dropped + 1 < it->seg; ++it->dropped)
+            seg_drop(sp, &sp->segs[(sp->first + it->dropped) % sp->cap]);
+        while (n < max) {
+            size_t len;
+            if (it->pos == it->end) {
+                if (it->seg == sp->nsegs)
+                    break;
+                const spill_seg_t *const seg =
+                    &sp->segs[(sp->first + it->seg++) % sp->cap];
+                it->pos = sp->map + seg->off;
+                it->end = it->pos + seg->bytes;
+            }
+            memcpy(&len, it->pos, sizeof(len));
+            out[n++] = it->pos + sizeof(len);
+            it->pos += sizeof(len) + len;
+        }
+        if (n == max)
+            break;
+        e = sp->back;
+        it->spill = NULL;
+    }
 
-    span = ele_sort(q->head, q->size, cmp);
-    q->head = span.head;
-    q->tail = span.tail;
+    it->next = e;
+    return n;
 }
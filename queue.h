@@ -6,11 +6,20 @@
  * operations.
  *
  * It uses a singly-linked list to represent the set of queue elements
+ *
+ * Each element keeps the length of its value, so that values may be any
+ * bytes, zero bytes included; a zero byte follows each of them so that it
+ * also reads as a string. The string operations wrap the byte ones.
+ * Sorting, merging and deduplication by strcmp or negstrcmp compare values
+ * by their bytes and lengths. Other comparators, the hash index, grouping,
+ * deduplication without a comparator, and the operations taking a string
+ * argument see values up to their first zero byte.
  */
 
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "allocator.h"
 #include "compare.h"
 
 /* Data structure declarations */
@@ -22,15 +31,94 @@ typedef struct ELE {
      */
     char *value;
     struct ELE *next;
+    size_t len; /* The length of value, without its zero terminator */
 } list_ele_t;
 
+/* Skip-list index over a sorted queue, defined in queue.c */
+struct SKIPIDX;
+
+/* Preallocated storage of a bounded queue, defined in queue.c */
+struct QPOOL;
+
+/* Hash index of the values of a queue, defined in queue.c */
+struct QINDEX;
+
+/* Elements spilled to disk, defined in queue.c */
+struct QSPILL;
+
+/* Pointers to evenly spaced elements, defined in queue.c */
+struct QSEGIDX;
+
+/* State of compaction, defined in queue.c */
+struct QCOMPACT;
+
+/* State of allocation from huge pages, defined in queue.c */
+struct QHUGE;
+
 /* Queue structure */
 typedef struct {
-    list_ele_t *head; /* Linked list of elements */
-    list_ele_t *tail; /* The tail element of the list */
-    size_t size;      /* The size of the list */
+    list_ele_t *head;     /* Linked list of elements */
+    list_ele_t *tail;     /* The tail element of the list */
+    size_t size;          /* The size of the list */
+    struct SKIPIDX *skip; /* Index used by sorted insertion, or NULL */
+    struct QPOOL *pool;   /* Storage of a bounded queue, or NULL */
+    void *scratch;        /* Working space kept between operations */
+    size_t scratch_size;  /* The size of scratch in bytes */
+    struct QINDEX *index; /* Counts of values, or NULL */
+    size_t sort_budget;   /* Bytes sorted in memory, 0 if unlimited */
+    struct QSPILL *spill; /* Elements kept on disk, or NULL */
+    /* The first `sorted_len` elements, up to `sorted_tail`, are sorted in
+     * ascending order by `sorted_cmp` */
+    cmp_func_t sorted_cmp;
+    size_t sorted_len;
+    list_ele_t *sorted_tail;
+    struct QSEGIDX *seg;      /* Every k-th element, or NULL */
+    struct QCOMPACT *compact; /* Progress of compaction, or NULL */
+    struct QHUGE *huge;       /* Allocation from huge pages, or NULL */
+    allocator_t *alloc;       /* Allocator of elements, or NULL for malloc */
 } queue_t;
 
+/* Result of an attempt to insert */
+typedef enum {
+    Q_OK,   /* The element is inserted */
+    Q_FAIL, /* The queue is NULL or could not allocate space */
+    Q_FULL, /* The queue is bounded and has no space left */
+} q_status_t;
+
+/* Shape and upkeep of a segment index */
+typedef struct {
+    size_t k;        /* The distance between indexed elements, 0 if none */
+    size_t entries;  /* The number of indexed elements */
+    size_t bytes;    /* The size of the index */
+    size_t updates;  /* Entries added or dropped by head and tail operations */
+    size_t rebuilds; /* Times it was built in one pass over the queue */
+} q_seg_stats_t;
+
+/* Source of the memory of elements */
+typedef enum {
+    Q_HUGE_OFF, /* Allocated one by one */
+    Q_HUGE_THP, /* Regions advised to use transparent huge pages */
+    Q_HUGE_TLB, /* Regions of reserved huge pages, or else as Q_HUGE_THP */
+} q_huge_t;
+
+/* Regions of huge pages mapped for a queue */
+typedef struct {
+    q_huge_t mode;  /* The source in use */
+    size_t regions; /* The number of regions mapped */
+    size_t hugetlb; /* Those of reserved huge pages */
+    size_t advised; /* Those advised to use transparent huge pages */
+} q_huge_stats_t;
+
+/* Read-only iterator over the values of a queue */
+typedef struct {
+    const list_ele_t *next;     /* The element to be visited next */
+    const struct QSPILL *spill; /* Spilled elements still to visit */
+    size_t seg;                 /* The number of segments visited */
+    size_t dropped;             /* Those dropped from memory */
+    const char *pos;            /* The next record of the segment */
+    const char *end;            /* The end of the segment */
+} q_iter_t;
+
 /* Operations on queue */
 
 /*
@@ -39,12 +127,56 @@ typedef struct {
  */
 queue_t *q_new();
 
+/*
+ * Create empty queue whose elements and their strings are taken from the
+ * allocator a, as declared in allocator.h. The queue itself and its
+ * indexes are allocated by malloc.
+ * The queue owns a from then on, and q_free() destroys it after freeing the
+ * elements. Elements only move between queues of the same allocator, and
+ * they stay in it: such a queue is neither compacted nor allocated from
+ * huge pages.
+ * Return NULL, leaving a to the caller, if a is NULL or could not allocate
+ * space.
+ */
+queue_t *q_new_with_allocator(allocator_t *a);
+
+/*
+ * Create empty queue holding at most capacity strings of at most max_strlen
+ * characters. Longer strings are truncated.
+ * All the space is allocated here; later operations on the queue neither
+ * allocate nor free, except sorted insertion which maintains an index.
+ * Return NULL if could not allocate space or capacity is 0.
+ */
+queue_t *q_new_bounded(size_t capacity, size_t max_strlen);
+
+/*
+ * Make a full bounded queue drop its head on tail insertion instead of
+ * refusing the new element, so that it works as a ring log.
+ * No effect if q is NULL or not bounded.
+ */
+void q_set_overwrite(queue_t *q, bool overwrite);
+
+/*
+ * Return the maximum number of elements of a bounded queue.
+ * Return 0 if q is NULL or not bounded.
+ */
+size_t q_capacity(const queue_t *q);
+
 /*
  * Free ALL storage used by queue.
  * No effect if q is NULL
  */
 void q_free(queue_t *q);
 
+/*
+ * Free ALL storage used by queue on a background thread, as declared in
+ * reclaim.h, so that the caller does not wait for it.
+ * The queue must not be used anymore once passed.  Wait with
+ * reclaim_drain() before checking that all storage is freed.
+ * No effect if q is NULL
+ */
+void q_free_async(queue_t *q);
+
 /*
  * Attempt to insert element at head of queue.
  * Return true if successful.
@@ -63,6 +195,17 @@ bool q_insert_head(queue_t *q, char *s);
  */
 bool q_insert_tail(queue_t *q, char *s);
 
+/*
+ * Attempt to insert element at head or tail of queue, telling a full bounded
+ * queue apart from other failures.
+ * Return Q_OK if successful.
+ * Return Q_FULL if q is bounded and full. When q is set to overwrite, tail
+ * insertion drops the head instead.
+ * Return Q_FAIL if q is NULL or could not allocate space.
+ */
+q_status_t q_try_insert_head(queue_t *q, char *s);
+q_status_t q_try_insert_tail(queue_t *q, char *s);
+
 /*
  * Attempt to remove element from head of queue.
  * Return true if successful.
@@ -73,12 +216,48 @@ bool q_insert_tail(queue_t *q, char *s);
  */
 bool q_remove_head(queue_t *q, char *sp, size_t bufsize);
 
+/*
+ * Attempt to insert an element holding the len bytes at p at head or tail
+ * of queue. The bytes may include zeros. A bounded queue keeps at most its
+ * maximum string length of them.
+ * Return true if successful.
+ * Return false if q is NULL, p is NULL and len is not 0, q is bounded and
+ * full, or could not allocate space.
+ */
+bool q_insert_head_bytes(queue_t *q, const void *p, size_t len);
+bool q_insert_tail_bytes(queue_t *q, const void *p, size_t len);
+
+/*
+ * Attempt to remove element from head of queue.
+ * Return true if successful.
+ * Return false if queue is NULL or empty.
+ * If buf is non-NULL, copy the first bufsize bytes of the removed value, or
+ * all of them if fewer, to buf, without a terminator. If lenp is non-NULL,
+ * set *lenp to the length of the value, which may exceed bufsize.
+ */
+bool q_remove_head_bytes(queue_t *q, void *buf, size_t bufsize, size_t *lenp);
+
+/*
+ * Return the value of the head of queue, followed by a zero byte, and set
+ * *lenp to its length if lenp is non-NULL. The value stays valid until the
+ * queue is next changed.
+ * Return NULL if queue is NULL or empty.
+ */
+const void *q_peek_head_bytes(queue_t *q, size_t *lenp);
+
 /*
  * Return number of elements in queue.
  * Return 0 if q is NULL or empty
+ * Return INT_MAX if there are more; q_size64 counts them all.
  */
 int q_size(queue_t *q);
 
+/*
+ * Return number of elements in queue, however many.
+ * Return 0 if q is NULL or empty
+ */
+size_t q_size64(queue_t *q);
+
 /*
  * Reverse elements in queue
  * No effect if q is NULL or empty
@@ -92,7 +271,261 @@ void q_reverse(queue_t *q);
  * Sort elements of queue in ascending order
  * No effect if q is NULL or empty. In addition, if q has only one
  * element, do nothing.
+ * The queue remembers how long a prefix is already sorted by cmp, as left by
+ * sorting and by insertion at either end. Only the elements after it are
+ * sorted, then merged with it, and there is nothing to do if it covers the
+ * whole queue. Another comparator makes the whole queue sorted again.
+ * The comparators ordering strings by their bytes (strcasecmp, strcmp and
+ * their negations) sort by the first 8 bytes as integer keys, then by the
+ * next 8 bytes where keys are equal and so on, if the scratch space of q has
+ * room for n elements as reserved by q_reserve_sort_scratch(q, n). Otherwise
+ * the list is merge sorted.
+ * If the elements take more bytes than the sort budget of queue, they are
+ * sorted in runs written to a temporary file and merged back, which
+ * allocates a few buffers; on failure, it falls back to sorting in memory.
+ * A queue with spilled elements is sorted that way in its own file instead,
+ * so that its elements are not read back, allocating about the budget.
  */
 void q_sort(queue_t *q, cmp_func_t cmp);
 
+/*
+ * Set the number of bytes of elements which q_sort sorts in memory at once.
+ * A budget of 0, the default, means unlimited.
+ * No effect if q is NULL.
+ */
+void q_set_sort_budget(queue_t *q, size_t bytes);
+
+/*
+ * Delete the elements equal to an earlier one, keeping the first of each
+ * value in place.
+ * If cmp is non-NULL, the queue is taken as sorted by cmp, and elements for
+ * which cmp returns 0 are equal; it takes one pass with no allocation.
+ * If cmp is NULL, the queue may be in any order, and elements holding the
+ * same string are equal; it takes O(n) expected time with a hash table.
+ * Return false if q is NULL or could not allocate space, with no effect.
+ */
+bool q_delete_dup(queue_t *q, cmp_func_t cmp);
+
+/*
+ * Move the k smallest elements by cmp to the head of queue in ascending
+ * order, leaving the others after them in unspecified order.
+ * It takes O(n log k) time with a heap of k element pointers.
+ * The heap lives in the scratch space of q, which is grown if it is
+ * smaller than reserved by q_reserve_sort_scratch(q, k).
+ * Return false, with no effect, if q is NULL or could not allocate space.
+ * If k is at least the size of queue, this is the same as q_sort.
+ */
+bool q_sort_topk(queue_t *q, size_t k, cmp_func_t cmp);
+
+/*
+ * Rearrange the elements so that the ones holding the same string are
+ * contiguous. The groups come in the order of their first elements, and
+ * each keeps the order of its elements.
+ * It takes O(n) expected time with a bucket table in the scratch space of
+ * q, which is grown if it is smaller than reserved by
+ * q_reserve_scratch(q, n) for the size n of queue.
+ * Return false, with no effect, if q is NULL or could not allocate space.
+ */
+bool q_group(queue_t *q);
+
+/*
+ * Make sure that operations needing working space for n elements do not
+ * allocate, which is useful before entering a section where allocation is
+ * not allowed. The space is kept until the queue is freed, even for a
+ * bounded queue.
+ * Return false if q is NULL or could not allocate space.
+ */
+bool q_reserve_scratch(queue_t *q, size_t n);
+
+/*
+ * Like q_reserve_scratch, for sorting only, which needs a fraction of the
+ * space of grouping.
+ * Return false if q is NULL or could not allocate space.
+ */
+bool q_reserve_sort_scratch(queue_t *q, size_t n);
+
+/*
+ * Merge the elements of dst and of queues[0..k-1], each sorted in ascending
+ * order by cmp, into dst in the same order. The other queues become empty.
+ * NULL entries, empty queues and dst itself in queues are ignored.
+ * No element is allocated or freed; it takes O(n log k) comparisons.
+ * Return false, with no effect, if dst is NULL or any queue is bounded,
+ * has a hash index, or has another allocator than dst.
+ */
+bool q_merge_sorted(queue_t *dst, queue_t *queues[], size_t k, cmp_func_t cmp);
+
+/*
+ * Attempt to insert element in ascending order according to cmp.
+ * Return true if successful.
+ * Return false if q is NULL or could not allocate space.
+ * The queue is sorted first if it is not already sorted by cmp.
+ * The element is placed after the elements that compare equal to it.
+ * Successive calls with the same cmp take O(log n) expected time.
+ */
+bool q_insert_sorted(queue_t *q, char *s, cmp_func_t cmp);
+
+/*
+ * Return the value of the first element which is not less than s,
+ * provided that the queue is sorted by cmp.
+ * Return NULL if there is no such element or q is NULL.
+ * It takes O(log n) expected time after q_insert_sorted() with the same cmp,
+ * and O(n) time otherwise.
+ */
+const char *q_lower_bound(queue_t *q, const char *s, cmp_func_t cmp);
+
+/*
+ * Switch the hash index of queue on or off.
+ * Switching it on builds it from the elements in O(n) time; from then on
+ * insertion and removal keep it up to date, and sorting and reversing do not
+ * touch it. Insertion allocates for the index even in a bounded queue.
+ * Return false if q is NULL or could not allocate space, in which case the
+ * queue is left without index.
+ */
+bool q_set_index(queue_t *q, bool on);
+
+/*
+ * Return whether queue has a hash index.
+ * Return false if q is NULL.
+ */
+bool q_has_index(const queue_t *q);
+
+/*
+ * Return the number of elements holding string s.
+ * It takes O(1) expected time with a hash index, and O(n) time otherwise.
+ * Return 0 if q is NULL.
+ */
+size_t q_count(const queue_t *q, const char *s);
+
+/*
+ * Return whether any element holds string s.
+ * It takes O(1) expected time with a hash index, and O(n) time otherwise.
+ * Return false if q is NULL.
+ */
+bool q_contains(const queue_t *q, const char *s);
+
+/*
+ * Keep at most about limit elements of queue in memory, spilling the ones
+ * in the middle to a temporary file in segments of limit / 2 elements.
+ * Tail insertion spills a segment once the elements after the spilled ones
+ * fill one, and head removal reads the oldest segment back once the
+ * elements before them are gone, so both stay O(1) amortized.
+ * Head insertion and the iterator leave the spilled elements on disk; the
+ * other operations on the whole queue first read them all back with
+ * q_unspill(), and have no effect if that fails.
+ * A limit of 0 reads all elements back and stops spilling.
+ * Return false if q is NULL or bounded, or could not allocate space.
+ */
+bool q_set_spill(queue_t *q, size_t limit);
+
+/*
+ * Read all spilled elements of queue back into memory. Spilling goes on
+ * with later tail insertions.
+ * Return true if none is left on disk.
+ * Return false if q is NULL or could not allocate space.
+ */
+bool q_unspill(queue_t *q);
+
+/*
+ * Return the number of elements of queue kept on disk.
+ * Return 0 if q is NULL.
+ */
+size_t q_spilled(const queue_t *q);
+
+/*
+ * Keep a pointer to every k-th element of queue, so that the element at any
+ * position is reached in O(k) time.
+ * Insertion and removal at either end keep it up to date in O(1) amortized
+ * time. After other operations moving elements, such as reversing and
+ * sorting, it is rebuilt in O(n) time on next use.
+ * While up to date, it also splits the list for q_free() and q_reverse(),
+ * which then walk up to 8 parts at once to overlap their cache misses, as
+ * they do with a sorted queue's skip index.
+ * A bounded queue reserves the index for its capacity here, so that its
+ * insertion still does not allocate.
+ * A distance of 0 drops the index.
+ * Return false if q is NULL or could not allocate space.
+ */
+bool q_set_segments(queue_t *q, size_t k);
+
+/*
+ * Return the value of the element at position pos of queue, counting from 0
+ * at the head.
+ * Spilled elements are read back first.
+ * Return NULL if q is NULL, pos is not less than the size of queue, or
+ * could not allocate space.
+ */
+const char *q_value_at(queue_t *q, size_t pos);
+
+/*
+ * Move the elements of queue from position pos on to the empty queue rest,
+ * in the same order. No element is allocated or freed.
+ * Finding the cut takes O(k) time with a segment index, and O(pos) time
+ * otherwise.
+ * Return false, with no effect, if q or rest is NULL, rest is q or is not
+ * empty, either queue is bounded or has a hash index, the queues have
+ * different allocators, pos is greater than the size of queue, or spilled
+ * elements could not be read back.
+ */
+bool q_split(queue_t *q, size_t pos, queue_t *rest);
+
+/*
+ * Move elements of queue, with their strings, into fresh contiguous blocks
+ * in list order, so that traversals touch memory in sequence, and free the
+ * old ones.
+ * Each call moves at most max elements, going on from where the previous
+ * call stopped, so that compaction can be spread over many calls. A pass
+ * ends at the tail; the call after that starts a new one from the head.
+ * Operations moving elements out of order also restart the pass. Spilled
+ * elements and the ones after them are left alone.
+ * A block is freed once all its elements are removed, so that a queue
+ * emptied from the head releases its memory as it goes.
+ * Return the number of elements moved, which is less than max once the
+ * pass is over, or if q is NULL, bounded or has its own allocator, or could
+ * not allocate space.
+ */
+size_t q_compact(queue_t *q, size_t max);
+
+/*
+ * Allocate the elements of queue, with their strings, from 2 MiB regions
+ * aligned to 2 MiB, so that traversals of a large queue touch few pages and
+ * miss the TLB rarely.
+ * Q_HUGE_THP advises the kernel to back the regions with transparent huge
+ * pages. Q_HUGE_TLB takes them from the reserved huge pages, and falls back
+ * to Q_HUGE_THP once none is left.  A region the kernel does not back with
+ * huge pages still holds elements contiguously.  Elements are allocated one
+ * by one if no region could be mapped.
+ * Compaction lays elements out in regions too while the mode is on.
+ * A region is unmapped once all its elements are removed.
+ * Q_HUGE_OFF goes back to allocating elements one by one; the elements
+ * already in regions stay there.
+ * Return false if q is NULL, bounded or has its own allocator, or could not
+ * allocate space.
+ */
+bool q_set_huge_pages(queue_t *q, q_huge_t mode);
+
+/*
+ * Fill stats with the regions of huge pages mapped for queue so far.
+ * They are all 0 if q is NULL or never allocated from huge pages.
+ */
+void q_huge_stats(const queue_t *q, q_huge_stats_t *stats);
+
+/*
+ * Fill stats with the shape and the upkeep of the segment index of queue.
+ * They are all 0 if q is NULL or has no index.
+ */
+void q_segment_stats(const queue_t *q, q_seg_stats_t *stats);
+
+/*
+ * Start iterating over the values of queue from its head.
+ * The iteration over a NULL queue is empty.
+ */
+void q_iter_init(q_iter_t *it, const queue_t *q);
+
+/*
+ * Fetch the values of the next (at most max) elements into out.
+ * Return the number of values fetched; return 0 once all are visited.
+ * The values are not copied. They remain valid until the queue is modified.
+ */
+size_t q_iter_next_batch(q_iter_t *it, const char **out, size_t max);
+
 #endif /* LAB0_QUEUE_H */
@@ -0,0 +1,170 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* The reclaimer adjusts the checks of its own frees */
+#define INTERNAL 1
+#include "harness.h"
+#include "reclaim.h"
+
+/* Structure waiting to be freed */
+typedef struct RECLAIMJOB {
+    void *obj;
+    reclaim_func_t free_fn;
+    struct RECLAIMJOB *next;
+} reclaim_job_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when jobs are submitted */
+static pthread_cond_t work = PTHREAD_COND_INITIALIZER;
+/* Signaled when no job is left */
+static pthread_cond_t idle = PTHREAD_COND_INITIALIZER;
+
+static reclaim_job_t *jobs = NULL; /* Jobs not taken yet, newest first */
+static size_t pending = 0;         /* Jobs submitted but not done */
+static size_t finished = 0;        /* Jobs done by the reclaimer */
+static size_t errors = 0;          /* Jobs which ran into errors */
+static bool started = false;       /* Whether the reclaimer is running */
+
+/*
+ * Block all signals of the calling thread while it holds the lock, so that
+ * the timeout handler of the harness cannot jump out of it.  The previous
+ * mask is saved in `old`.
+ */
+static void lock_acquire(sigset_t *old)
+{
+    sigset_t all;
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, old);
+    pthread_mutex_lock(&lock);
+}
+
+static void lock_release(const sigset_t *old)
+{
+    pthread_mutex_unlock(&lock);
+    pthread_sigmask(SIG_SETMASK, old, NULL);
+}
+
+/*
+ * Run the jobs, oldest first, a batch of all those waiting at a time.
+ * The thread starts with all signals blocked, so that the timeout alarm is
+ * always delivered to the thread running the tests.
+ */
+static void *reclaimer(void *arg)
+{
+    /*
+     * The structures were dropped by the tests already; looking each block
+     * up in the whole list of blocks would make freeing them quadratic
+     */
+    set_cautious_mode(false);
+    /* Reporting is not thread-safe; errors are counted instead */
+    set_quiet_mode(true);
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        reclaim_job_t *batch = NULL;
+        size_t n = 0, failed = 0;
+
+        while (!jobs)
+            pthread_cond_wait(&work, &lock);
+        while (jobs) {
+            reclaim_job_t *const job = jobs;
+            jobs = job->next;
+            job->next = batch;
+            batch = job;
+        }
+        pthread_mutex_unlock(&lock);
+
+        while (batch) {
+            reclaim_job_t *const job = batch;
+            batch = job->next;
+            job->free_fn(job->obj);
+            free(job);
+            ++n;
+            /* Errors of the harness are flagged for this thread only */
+            if (error_check())
+                ++failed;
+        }
+
+        pthread_mutex_lock(&lock);
+        pending -= n;
+        finished += n;
+        errors += failed;
+        if (!pending)
+            pthread_cond_broadcast(&idle);
+    }
+    return NULL;
+}
+
+void reclaim_submit(void *obj, reclaim_func_t free_fn)
+{
+    reclaim_job_t *const job = malloc(sizeof(reclaim_job_t));
+    sigset_t old;
+
+    lock_acquire(&old);
+    if (job && !started) {
+        /* The new thread inherits the blocked signals */
+        pthread_t tid;
+        started = !pthread_create(&tid, NULL, reclaimer, NULL);
+        if (started)
+            pthread_detach(tid);
+    }
+    if (!job || !started) {
+        lock_release(&old);
+        free(job);
+        free_fn(obj);
+        return;
+    }
+    job->obj = obj;
+    job->free_fn = free_fn;
+    job->next = jobs;
+    jobs = job;
+    ++pending;
+    pthread_cond_signal(&work);
+    lock_release(&old);
+}
+
+void reclaim_drain()
+{
+    sigset_t old;
+
+    lock_acquire(&old);
+    while (pending)
+        pthread_cond_wait(&idle, &lock);
+    lock_release(&old);
+}
+
+size_t reclaim_pending()
+{
+    sigset_t old;
+    size_t n;
+
+    lock_acquire(&old);
+    n = pending;
+    lock_release(&old);
+    return n;
+}
+
+size_t reclaim_finished()
+{
+    sigset_t old;
+    size_t n;
+
+    lock_acquire(&old);
+    n = finished;
+    lock_release(&old);
+    return n;
+}
+
+size_t reclaim_errors()
+{
+    sigset_t old;
+    size_t n;
+
+    lock_acquire(&old);
+    n = errors;
+    lock_release(&old);
+    return n;
+}
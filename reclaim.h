@@ -0,0 +1,42 @@
+#ifndef LAB0_RECLAIM_H
+#define LAB0_RECLAIM_H
+
+/*
+ * This program frees structures on a background thread.
+ *
+ * Dropping a large structure then takes constant time for the caller, while
+ * the reclaimer thread walks and frees it.  The thread is started on first
+ * use and takes all the structures submitted so far as one batch each time
+ * it wakes up.  Leak checks should drain it before counting blocks.
+ */
+
+#include <stddef.h>
+
+/* Function freeing a structure with all it owns */
+typedef void (*reclaim_func_t)(void *obj);
+
+/*
+ * Have the reclaimer call free_fn(obj).
+ * It is called right away on the calling thread if the reclaimer could not
+ * be started or the request could not be recorded.
+ */
+void reclaim_submit(void *obj, reclaim_func_t free_fn);
+
+/* Wait until all the structures submitted so far are freed */
+void reclaim_drain();
+
+/* Return the number of structures submitted but not freed yet */
+size_t reclaim_pending();
+
+/* Return the number of structures freed by the reclaimer */
+size_t reclaim_finished();
+
+/*
+ * Return the number of structures whose freeing by the reclaimer ran into
+ * errors of the harness, such as freeing a block twice.
+ * The reclaimer reports no error itself, not even a fatal one such as
+ * running out of memory; they are all counted here instead.
+ */
+size_t reclaim_errors();
+
+#endif /* LAB0_RECLAIM_H */
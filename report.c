@@ -79,6 +79,7 @@ void report_event(message_t msg, char *fmt, ...)
         fflush(logfile);
         va_end(ap);
         fclose(logfile);
+        logfile = NULL;
     }
 
     if (fatal) {
@@ -151,8 +152,10 @@ static void fail_fun(char *format, char *msg)
     if (fatal_fun)
         fatal_fun();
 
-    if (logfile)
+    if (logfile) {
         fclose(logfile);
+        logfile = NULL;
+    }
 
     exit(1);
 }
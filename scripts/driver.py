@@ -39,6 +39,48 @@ class Tracer:
         18: "trace-18-natsort",
         19: "trace-19-natsort",
         20: "trace-20-natsort",
+        21: "trace-21-pqueue",
+        22: "trace-22-pqueue-perf",
+        23: "trace-23-sorted",
+        24: "trace-24-sorted-perf",
+        25: "trace-25-bounded",
+        26: "trace-26-bounded-perf",
+        27: "trace-27-lru",
+        28: "trace-28-lru-perf",
+        29: "trace-29-typed",
+        30: "trace-30-typed-perf",
+        31: "trace-31-merge",
+        32: "trace-32-merge-perf",
+        33: "trace-33-topk",
+        34: "trace-34-topk-perf",
+        35: "trace-35-dedup",
+        36: "trace-36-dedup-perf",
+        37: "trace-37-index",
+        38: "trace-38-index-perf",
+        39: "trace-39-group",
+        40: "trace-40-group-perf",
+        41: "trace-41-extsort",
+        42: "trace-42-extsort-perf",
+        43: "trace-43-spill",
+        44: "trace-44-spill-perf",
+        45: "trace-45-resort",
+        46: "trace-46-resort-perf",
+        47: "trace-47-keysort",
+        48: "trace-48-keysort-perf",
+        49: "trace-49-segments",
+        50: "trace-50-segments-perf",
+        51: "trace-51-compact",
+        52: "trace-52-compact-perf",
+        54: "trace-54-chains",
+        55: "trace-55-chains-perf",
+        56: "trace-56-free-async",
+        57: "trace-57-hugepages",
+        58: "trace-58-hugepages-perf",
+        59: "trace-59-arena",
+        60: "trace-60-arena-perf",
+        61: "trace-61-allocators",
+        62: "trace-62-allocators-perf",
+        63: "trace-63-bytes",
     }
 
     traceProbs = {
@@ -62,9 +104,51 @@ class Tracer:
         18: "Trace-18",
         19: "Trace-19",
         20: "Trace-20",
+        21: "Trace-21",
+        22: "Trace-22",
+        23: "Trace-23",
+        24: "Trace-24",
+        25: "Trace-25",
+        26: "Trace-26",
+        27: "Trace-27",
+        28: "Trace-28",
+        29: "Trace-29",
+        30: "Trace-30",
+        31: "Trace-31",
+        32: "Trace-32",
+        33: "Trace-33",
+        34: "Trace-34",
+        35: "Trace-35",
+        36: "Trace-36",
+        37: "Trace-37",
+        38: "Trace-38",
+        39: "Trace-39",
+        40: "Trace-40",
+        41: "Trace-41",
+        42: "Trace-42",
+        43: "Trace-43",
+        44: "Trace-44",
+        45: "Trace-45",
+        46: "Trace-46",
+        47: "Trace-47",
+        48: "Trace-48",
+        49: "Trace-49",
+        50: "Trace-50",
+        51: "Trace-51",
+        52: "Trace-52",
+        54: "Trace-54",
+        55: "Trace-55",
+        56: "Trace-56",
+        57: "Trace-57",
+        58: "Trace-58",
+        59: "Trace-59",
+        60: "Trace-60",
+        61: "Trace-61",
+        62: "Trace-62",
+        63: "Trace-63",
     }
 
-    maxScores = [0, 6, 6, 6, 6, 5, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 5, 4, 4, 5]
+    maxScores = [0, 6, 6, 6, 6, 5, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 5, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5]
 
     RED = '\033[91m'
     GREEN = '\033[92m'
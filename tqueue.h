@@ -0,0 +1,206 @@
+#ifndef LAB0_TQUEUE_H
+#define LAB0_TQUEUE_H
+
+/*
+ * Generator of type-specialized queues.
+ *
+ * Each queue holds its values inline in the list elements, so inserting a
+ * value takes a single allocation and no copy of a string.  Its sort calls
+ * the comparator directly, which lets the compiler inline it.
+ *
+ * Declare the queue named `name` in a header with
+ *     QUEUE_DECLARE(name, type)
+ * and define it in exactly one source file with
+ *     QUEUE_DEFINE(name, type, cmp)
+ * where `cmp(a, b)` takes two `const type *` and returns a negative, zero or
+ * positive int like strcmp.  It may be a function or a function-like macro.
+ *
+ * The generated interface mirrors the one of queue.h:
+ *     name_t *name_new();
+ *     void name_free(name_t *q);
+ *     bool name_insert_head(name_t *q, type v);
+ *     bool name_insert_tail(name_t *q, type v);
+ *     bool name_remove_head(name_t *q, type *vp);
+ *     size_t name_size(const name_t *q);
+ *     void name_reverse(name_t *q);
+ *     void name_sort(name_t *q);
+ * The source file defining the queue should include harness.h to have its
+ * allocations checked.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define QUEUE_DECLARE(name, type)                                  \
+    /* Linked list element holding its value inline */             \
+    typedef struct name##_ele {                                    \
+        type value;                                                \
+        struct name##_ele *next;                                   \
+    } name##_ele_t;                                                \
+                                                                   \
+    /* Queue structure */                                          \
+    typedef struct {                                               \
+        name##_ele_t *head; /* Linked list of elements */          \
+        name##_ele_t *tail; /* The tail element of the list */     \
+        size_t size;        /* The size of the list */             \
+    } name##_t;                                                    \
+                                                                   \
+    /* Create empty queue. Return NULL if could not allocate. */   \
+    name##_t *name##_new();                                        \
+    /* Free all storage used by queue. No effect if q is NULL */   \
+    void name##_free(name##_t *q);                                 \
+    /* Insert v at head. Return false if q is NULL or could not    \
+     * allocate space */                                           \
+    bool name##_insert_head(name##_t *q, type v);                  \
+    /* Insert v at tail. Return false if q is NULL or could not    \
+     * allocate space */                                           \
+    bool name##_insert_tail(name##_t *q, type v);                  \
+    /* Remove head, copying its value to *vp if vp is non-NULL.     \
+     * Return false if q is NULL or empty */                       \
+    bool name##_remove_head(name##_t *q, type *vp);                \
+    /* Return number of elements, 0 if q is NULL or empty */       \
+    size_t name##_size(const name##_t *q);                         \
+    /* Reverse elements without allocating or freeing any */       \
+    void name##_reverse(name##_t *q);                              \
+    /* Sort elements in ascending order of the comparator */       \
+    void name##_sort(name##_t *q);
+
+#define QUEUE_DEFINE(name, type, cmp)                                        \
+    name##_t *name##_new()                                                   \
+    {                                                                        \
+        name##_t *q = malloc(sizeof(name##_t));                              \
+        if (!q)                                                              \
+            return NULL;                                                     \
+        q->head = q->tail = NULL;                                            \
+        q->size = 0;                                                         \
+        return q;                                                            \
+    }                                                                        \
+                                                                             \
+    void name##_free(name##_t *q)                                            \
+    {                                                                        \
+        if (!q)                                                              \
+            return;                                                          \
+        for (name##_ele_t *e = q->head; e;) {                                \
+            name##_ele_t *const next = e->next;                              \
+            free(e);                                                         \
+            e = next;                                                        \
+        }                                                                    \
+        free(q);                                                             \
+    }                                                                        \
+                                                                             \
+    bool name##_insert_head(name##_t *q, type v)                             \
+    {                                                                        \
+        name##_ele_t *e;                                                     \
+        if (!q || !(e = malloc(sizeof(name##_ele_t))))                       \
+            return false;                                                    \
+        e->value = v;                                                        \
+        e->next = q->head;                                                   \
+        q->head = e;                                                         \
+        if (!q->tail)                                                        \
+            q->tail = e;                                                     \
+        q->size++;                                                           \
+        return true;                                                         \
+    }                                                                        \
+                                                                             \
+    bool name##_insert_tail(name##_t *q, type v)                             \
+    {                                                                        \
+        name##_ele_t *e;                                                     \
+        if (!q || !(e = malloc(sizeof(name##_ele_t))))                       \
+            return false;                                                    \
+        e->value = v;                                                        \
+        e->next = NULL;                                                      \
+        if (q->tail)                                                         \
+            q->tail->next = e;                                               \
+        else                                                                 \
+            q->head = e;                                                     \
+        q->tail = e;                                                         \
+        q->size++;                                                           \
+        return true;                                                         \
+    }                                                                        \
+                                                                             \
+    bool name##_remove_head(name##_t *q, type *vp)                           \
+    {                                                                        \
+        name##_ele_t *e;                                                     \
+        if (!q || !(e = q->head))                                            \
+            return false;                                                    \
+        if (vp)                                                              \
+            *vp = e->value;                                                  \
+        q->head = e->next;                                                   \
+        if (!q->head)                                                        \
+            q->tail = NULL;                                                  \
+        q->size--;                                                           \
+        free(e);                                                             \
+        return true;                                                         \
+    }                                                                        \
+                                                                             \
+    size_t name##_size(const name##_t *q) { return q ? q->size : 0; }        \
+                                                                             \
+    void name##_reverse(name##_t *q)                                         \
+    {                                                                        \
+        name##_ele_t *prev = NULL;                                           \
+        if (!q || !q->head)                                                  \
+            return;                                                          \
+        for (name##_ele_t *k = q->head; k;) {                                \
+            name##_ele_t *const next = k->next;                              \
+            k->next = prev;                                                  \
+            prev = k;                                                        \
+            k = next;                                                        \
+        }                                                                    \
+        q->tail = q->head;                                                   \
+        q->head = prev;                                                      \
+    }                                                                        \
+                                                                             \
+    /* Merge sort `len` elements starting with `head`, and set *tailp to    \
+     * the tail of the sorted list */                                        \
+    static name##_ele_t *name##_ele_sort(name##_ele_t *head, size_t len,     \
+                                         name##_ele_t **tailp)               \
+    {                                                                        \
+        name##_ele_t *left, *right, *merge, *ltail, *rtail;                  \
+        if (!head->next) {                                                   \
+            *tailp = head;                                                   \
+            return head;                                                     \
+        }                                                                    \
+        right = head;                                                        \
+        for (size_t k = 1; k < len / 2; k++)                                 \
+            right = right->next;                                             \
+        {                                                                    \
+            name##_ele_t *const next = right->next;                          \
+            right->next = NULL;                                              \
+            right = next;                                                    \
+        }                                                                    \
+        left = name##_ele_sort(head, len / 2, &ltail);                       \
+        right = name##_ele_sort(right, len - len / 2, &rtail);               \
+        {                                                                    \
+            name##_ele_t **const phead =                                     \
+                (cmp(&left->value, &right->value) <= 0) ? &left : &right;    \
+            merge = head = *phead;                                           \
+            *phead = (*phead)->next;                                         \
+        }                                                                    \
+        while (left && right) {                                              \
+            if (cmp(&left->value, &right->value) <= 0) {                     \
+                merge->next = left;                                          \
+                left = left->next;                                           \
+            } else {                                                         \
+                merge->next = right;                                         \
+                right = right->next;                                         \
+            }                                                                \
+            merge = merge->next;                                             \
+        }                                                                    \
+        if (left) {                                                          \
+            merge->next = left;                                              \
+            *tailp = ltail;                                                  \
+        } else {                                                             \
+            merge->next = right;                                             \
+            *tailp = rtail;                                                  \
+        }                                                                    \
+        return head;                                                         \
+    }                                                                        \
+                                                                             \
+    void name##_sort(name##_t *q)                                            \
+    {                                                                        \
+        if (!q || !q->head || !q->head->next)                                \
+            return;                                                          \
+        q->head = name##_ele_sort(q->head, q->size, &q->tail);               \
+    }
+
+#endif /* LAB0_TQUEUE_H */
@@ -0,0 +1,31 @@
+# Test of priority queue insert and remove minimum
+option fail 0
+option malloc 0
+pnew
+pi gerbil
+pi bear
+pi dolphin
+pr bear
+pi meerkat
+pi aardvark
+pi bear
+pr aardvark
+pr bear
+pr dolphin
+pr gerbil
+pr meerkat
+pi RAND 1000
+pr
+pr
+pr
+prq 997
+pfree
+option compare 3
+pnew
+pi gerbil
+pi bear
+pi dolphin
+pr gerbil
+pr dolphin
+pr bear
+pfree
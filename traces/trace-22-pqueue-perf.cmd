@@ -0,0 +1,24 @@
+# Test performance of interleaved insert and remove minimum
+# Priority queue: O(1) insert and O(log n) remove minimum
+option fail 0
+option malloc 0
+pnew
+time pi RAND 100000
+time prq 50000
+time pi RAND 100000
+time prq 50000
+time pi RAND 100000
+time prq 200000
+pfree
+# Queue: sort before draining each time
+new
+time ih RAND 100000
+time sort
+time rhq 50000
+time ih RAND 100000
+time sort
+time rhq 50000
+time ih RAND 100000
+time sort
+time rhq 200000
+free
@@ -0,0 +1,43 @@
+# Test of sorted insertion and lower bound
+option fail 0
+option malloc 0
+new
+is gerbil
+is bear
+is dolphin
+is meerkat
+is bear
+lb cat dolphin
+lb bear bear
+lb aardvark bear
+lb zebra
+rh bear
+rh bear
+is aardvark
+lb bear dolphin
+ih squirrel
+it jaguar
+is vulture
+rh aardvark
+rh dolphin
+rh gerbil
+rh jaguar
+rh meerkat
+rh squirrel
+rh vulture
+is RAND 1000
+rhq 1000
+free
+# Natural order
+option compare 4
+new
+is "pic10"
+is "pic2"
+is "pic100"
+is "pic1"
+lb "pic3" "pic10"
+rh "pic1"
+rh "pic2"
+rh "pic10"
+rh "pic100"
+free
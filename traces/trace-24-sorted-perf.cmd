@@ -0,0 +1,24 @@
+# Test performance of sorted insertion
+# Sorted insertion: O(log n) expected time per element
+option fail 0
+option malloc 0
+new
+time is RAND 100000
+time is RAND 100000
+time is RAND 100000
+time lb mmmm
+time rhq 150000
+time is RAND 100000
+free
+# Queue: insert at tail and sort again after each batch
+new
+time it RAND 100000
+time sort
+time it RAND 100000
+time sort
+time it RAND 100000
+time sort
+time rhq 150000
+time it RAND 100000
+time sort
+free
@@ -0,0 +1,36 @@
+# Test of bounded queue with preallocated space
+option fail 0
+option malloc 0
+new 4 8
+ih gerbil
+ih bear
+it dolphin
+it meerkat
+it vulture
+ih squirrel
+rh bear
+rh gerbil
+it aardvark_bear
+rh dolphin
+rh meerkat
+rh aardvark
+# Fault injection does not apply after creation
+option malloc 100
+ih jaguar 4
+it panda
+rhq 4
+ih jaguar 4
+reverse
+sort
+rh jaguar
+option malloc 0
+# Ring log
+option overwrite 1
+it bear 2
+it dolphin
+it gerbil
+rh bear
+rh bear
+rh dolphin
+rh gerbil
+free
@@ -0,0 +1,23 @@
+# Test performance of bounded queue
+# No allocation is allowed once the queue is created
+option fail 0
+option malloc 0
+new 1000000 8
+time ih dolphin 1000000
+time rhq 1000000
+time it gerbil 1000000
+time rhq 1000000
+# Ring log
+new 200000 8
+option overwrite 1
+time it RAND 1000000
+time reverse
+time sort
+free
+# Queue: allocate and free each element
+new
+time ih dolphin 1000000
+time rhq 1000000
+time it gerbil 1000000
+time rhq 1000000
+free
@@ -0,0 +1,27 @@
+# Test of recency list with capacity limit
+option fail 0
+option malloc 0
+lnew 3
+lt gerbil
+lt bear
+lt dolphin
+lt gerbil
+lt meerkat
+le dolphin
+lt bear
+lt vulture
+le meerkat
+le bear
+le vulture
+lt dolphin 5
+# Touching with allocation failures
+option fail 30
+option malloc 50
+lt jaguar 10
+lt dolphin
+lfree
+option malloc 0
+lnew
+lt RAND 100
+lt squirrel
+lfree
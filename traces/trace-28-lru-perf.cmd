@@ -0,0 +1,11 @@
+# Test performance of recency list on Zipf distributed strings
+option fail 0
+option malloc 0
+lnew 1000
+time lzipf 200000 100000
+lnew 10000
+time lzipf 200000 100000
+lnew
+time lzipf 200000 100000
+time lt RAND 100000
+lfree
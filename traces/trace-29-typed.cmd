@@ -0,0 +1,20 @@
+# Test of queue of integers generated by QUEUE_DEFINE
+option fail 0
+option malloc 0
+unew
+uit 5
+uit 3
+uit 18446744073709551615
+uit 0
+uit 3 2
+usort
+urh 0
+urh 3
+ureverse
+urh 18446744073709551615
+urh 5
+urh 3
+uit RAND 1000
+usort
+ureverse
+ufree
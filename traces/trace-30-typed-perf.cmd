@@ -0,0 +1,13 @@
+# Compare queue of integers holding values inline with queue of strings
+option fail 0
+option malloc 0
+unew
+time uit RAND 200000
+time usort
+time ureverse
+ufree
+new
+time it RAND 200000
+time sort
+time reverse
+free
@@ -0,0 +1,46 @@
+# Test of merging sorted queues
+option fail 0
+option malloc 0
+new
+it bear
+it gerbil
+it vulture
+option queue 1
+new
+it aardvark
+it dolphin
+it gerbil
+option queue 2
+new
+option queue 3
+new
+it meerkat
+it squirrel
+it zebra
+option queue 0
+merge
+option queue 1
+free
+option queue 2
+free
+option queue 3
+free
+# Merge with other comparison function
+option compare 2
+option queue 4
+new
+it RAND 500
+sort
+option queue 5
+new
+it RAND 300
+sort
+option queue 0
+sort
+merge
+option queue 4
+free
+option queue 5
+free
+option queue 0
+free
@@ -0,0 +1,58 @@
+# Test performance of merging sorted queues against sorting them all
+option fail 0
+option malloc 0
+option queue 1
+new
+it RAND 40000
+sort
+option queue 2
+new
+it RAND 40000
+sort
+option queue 3
+new
+it RAND 40000
+sort
+option queue 4
+new
+it RAND 40000
+sort
+option queue 5
+new
+it RAND 40000
+sort
+option queue 6
+new
+it RAND 40000
+sort
+option queue 7
+new
+it RAND 40000
+sort
+option queue 8
+new
+it RAND 40000
+sort
+option queue 0
+new
+time merge
+time sort
+time reverse
+time sort
+free
+option queue 1
+free
+option queue 2
+free
+option queue 3
+free
+option queue 4
+free
+option queue 5
+free
+option queue 6
+free
+option queue 7
+free
+option queue 8
+free
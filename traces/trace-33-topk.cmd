@@ -0,0 +1,35 @@
+# Test of sorting only the smallest elements to head
+option fail 0
+option malloc 0
+new
+it vulture
+it gerbil
+it meerkat
+it aardvark
+it dolphin
+it bear
+it zebra
+sort 3
+rh aardvark
+rh bear
+rh dolphin
+sort 0
+sort 1
+rh gerbil
+sort 10
+rh meerkat
+rh vulture
+rh zebra
+it RAND 1000
+sort 100
+option compare 3
+sort 1
+sort 999
+reverse
+sort 500
+free
+# Bounded queue
+new 100 8
+it RAND 100
+sort 20
+free
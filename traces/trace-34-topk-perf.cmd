@@ -0,0 +1,15 @@
+# Test performance of sorting only the smallest elements to head
+option fail 0
+option malloc 0
+new
+it RAND 500000
+it RAND 500000
+time sort 100
+time sort 100
+time sort 10000
+free
+new
+it RAND 200000
+time sort 100
+time sort
+free
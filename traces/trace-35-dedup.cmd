@@ -0,0 +1,52 @@
+# Test of deleting duplicates
+# The default comparison function ignores case
+option fail 0
+option malloc 0
+new
+it bear
+it dolphin
+it bear
+it gerbil
+it dolphin
+it aardvark
+it bear
+dedup hash
+rh bear
+rh dolphin
+rh gerbil
+rh aardvark
+it meerkat 3
+it bear
+it Bear
+it aardvark 2
+sort
+dedup
+rh aardvark
+# Either of bear and Bear is kept, since sorting may order them either way
+rh
+rh meerkat
+# Case-sensitive comparison tells bear from Bear
+option compare 1
+it BEAR
+it Bear
+it bear
+it bear
+dedup
+rh BEAR
+rh Bear
+rh bear
+it RAND 500
+it RAND 500
+sort
+dedup
+free
+# Bounded queue returns deleted elements to its pool
+new 10 8
+it dolphin 5
+dedup hash
+it gerbil 9
+sort
+dedup
+rh dolphin
+rh gerbil
+free
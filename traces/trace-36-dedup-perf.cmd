@@ -0,0 +1,15 @@
+# Test performance of deleting duplicates
+option fail 0
+option malloc 0
+new
+it dolphin 1000000
+time dedup hash
+it dolphin 1000000
+time dedup
+free
+new
+it RAND 300000
+time dedup hash
+time sort
+time dedup
+free
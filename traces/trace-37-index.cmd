@@ -0,0 +1,61 @@
+# Test of hash index for membership and count
+option fail 0
+option malloc 0
+new
+it gerbil
+it bear 3
+ih dolphin
+count bear 3
+option index 1
+count bear 3
+count gerbil 1
+count meerkat 0
+contains dolphin
+rh dolphin
+count dolphin 0
+is bear
+count bear 4
+# Sorting and reversing keep the index
+sort
+count bear 4
+reverse
+count gerbil 1
+dedup hash
+count bear 1
+it meerkat 2
+dedup hash
+count meerkat 1
+rh gerbil
+count gerbil 0
+option index 0
+count bear 1
+count meerkat 1
+free
+# Bounded queue with index
+option index 1
+new 3 8
+option overwrite 1
+it aardvark_bear
+it gerbil
+count aardvark 1
+it aardvark
+count aardvark 2
+it dolphin
+count aardvark 1
+count gerbil 1
+it dolphin
+count gerbil 0
+count dolphin 2
+option overwrite 0
+option index 0
+free
+# Allocation failures leave index consistent
+option index 1
+new
+option fail 30
+option malloc 50
+it jaguar 20
+option malloc 0
+option fail 0
+count jaguar
+free
@@ -0,0 +1,19 @@
+# Test performance of lookups with hash index
+option fail 0
+option malloc 0
+new
+it RAND 300000
+it RAND 300000
+it dolphin
+time option index 1
+time contains dolphin 1000000
+time contains RAND 1000000
+time reverse
+time contains dolphin 1000000
+time rhq 300000
+time it gerbil 300000
+time contains gerbil 1000000
+# Lookups without index scan the queue
+time option index 0
+time contains dolphin 3
+free
@@ -0,0 +1,36 @@
+# Test of grouping equal values without sorting
+option fail 0
+option malloc 0
+new
+group
+it gerbil
+group
+it bear
+it gerbil
+it dolphin
+it bear
+it gerbil
+it Bear
+group
+rh gerbil
+rh gerbil
+rh gerbil
+rh bear
+rh bear
+rh dolphin
+rh Bear
+it RAND 1000
+it dolphin 100
+ih dolphin 100
+it RAND 1000
+group
+free
+# Bounded queue
+new 20 8
+it meerkat 5
+it vulture 5
+ih meerkat 5
+ih vulture 5
+group
+rh vulture
+free
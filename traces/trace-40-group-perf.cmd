@@ -0,0 +1,23 @@
+# Test performance of grouping against sorting with many duplicates
+option fail 0
+option malloc 0
+new
+ih dolphin 100000
+it gerbil 100000
+ih bear 100000
+it meerkat 100000
+time group
+reverse
+time sort
+free
+# Natural comparison of strings with numbers
+option compare 5
+new
+ih dolphin100 100000
+it dolphin20 100000
+ih dolphin3 100000
+it dolphin100 100000
+time group
+reverse
+time sort
+free
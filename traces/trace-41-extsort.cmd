@@ -0,0 +1,93 @@
+# Test of sorting through a file beyond the sort budget
+option fail 0
+option malloc 0
+new
+option sortbudget 1
+it RAND 1000
+sort
+it RAND 1000
+ih dolphin 500
+reverse
+sort
+rhq 100
+option compare 2
+sort
+free
+# Queue within budget is sorted in memory
+option compare 0
+option sortbudget 1
+new
+it gerbil
+it bear
+it dolphin
+sort
+rh bear
+rh dolphin
+rh gerbil
+free
+# Bounded queue and hash index are kept
+option compare 1
+option sortbudget 1
+option index 1
+new 200 8
+it RAND 200
+it dolphin
+sort
+count dolphin 0
+rhq 150
+it dolphin 10
+sort
+count dolphin 10
+free
+option index 0
+option sortbudget 0
+# Failing file sort leaves the queue whole for sorting in memory
+option sortbudget 1
+option compare 1
+new
+it RAND 200
+sort
+it RAND 200
+option malloc 40
+sort
+option malloc 0
+it RAND 200
+option malloc 40
+sort
+option malloc 0
+it RAND 200
+option malloc 40
+sort
+option malloc 0
+it RAND 200
+option malloc 40
+sort
+option malloc 0
+it zebra
+rhq 1000
+rh zebra
+free
+option sortbudget 0
+# Spilled queue beyond the budget is sorted in its file, within the budget
+option sortbudget 64
+option compare 1
+option spill 1000
+new
+it RAND 50000
+ih ~zebra
+it Aardvark
+sort
+mem
+it ~~end
+ih Aa
+sort
+rh Aa
+rh Aardvark
+option compare 3
+sort
+rh ~~end
+rh ~zebra
+rhq 50000
+free
+option spill 0
+option sortbudget 0
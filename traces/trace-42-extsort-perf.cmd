@@ -0,0 +1,19 @@
+# Test performance of sorting through a file beyond the sort budget
+option fail 0
+option malloc 0
+new
+it RAND 150000
+it RAND 150000
+mem
+option sortbudget 4096
+time sort
+mem
+reverse
+option sortbudget 0
+time sort
+mem
+reverse
+option sortbudget 256
+time sort
+mem
+free
@@ -0,0 +1,64 @@
+# Test of spilling the middle of queue to a file
+option fail 0
+option malloc 0
+new
+option spill 4
+it a
+it b
+it c
+it d
+it e
+it f
+it g
+it h
+it i
+show
+contains e
+count g 1
+ih z
+rh z
+rh a
+rh b
+rh c
+rh d
+it j
+rh e
+size
+reverse
+rh j
+rh i
+it k 6
+option index 1
+count k 6
+rh h
+rh g
+rh f
+it l 5
+contains l
+option index 0
+rhq 6
+rh l
+option spill 0
+rh l
+free
+# Spilling a long queue at once, then sorting it
+option spill 0
+new
+it RAND 100
+it dolphin
+ih bear
+option spill 10
+it RAND 50
+sort
+option spill 3
+option compare 1
+sort
+rhq 152
+free
+# Bounded queue is never spilled
+option spill 2
+new 10 8
+it RAND 10
+rhq 10
+free
+option spill 0
@@ -0,0 +1,16 @@
+# Test performance of spilling the middle of queue to a file
+option fail 0
+option malloc 0
+new
+time it RAND 200000
+time it RAND 200000
+mem
+time rhq 400000
+mem
+option spill 20000
+time it RAND 200000
+time it RAND 200000
+mem
+time rhq 400000
+mem
+free
@@ -0,0 +1,57 @@
+# Test of sorting only what was appended after a sorted prefix
+option fail 0
+option malloc 0
+new
+it gerbil
+it bear
+it dolphin
+it meerkat
+sort
+it aardvark
+it zebra
+it bear
+sort
+rh aardvark
+rh bear
+rh bear
+ih alpaca
+it yak
+sort
+rh alpaca
+rh dolphin
+# Changing the comparator sorts everything again
+it Bear
+it Dolphin
+it cat
+option compare 1
+sort
+rh Bear
+rh Dolphin
+option compare 0
+sort
+rh cat
+rh gerbil
+reverse
+sort
+rh meerkat
+sort 1
+rh yak
+rh zebra
+free
+# Partial sort, insertion in order and deletion keep the prefix
+new
+it RAND 100
+sort 10
+it RAND 20
+sort
+it dolphin 3
+sort
+dedup
+it dolphin
+sort
+is alpaca
+it RAND 10
+sort
+rhq 115
+free
+option compare 0
@@ -0,0 +1,15 @@
+# Test performance of sorting only what was appended after a sorted prefix
+option fail 0
+option malloc 0
+new
+it RAND 300000
+time sort
+it RAND 3000
+time sort
+time sort
+it RAND 3000
+option compare 1
+time sort
+option compare 0
+time sort
+free
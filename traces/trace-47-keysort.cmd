@@ -0,0 +1,57 @@
+# Test of sorting by key prefixes with AVX2 and scalar kernels
+option fail 0
+option malloc 0
+new
+it alpha
+it Alpha
+it alphabetical
+it alphabet
+it alphabetic
+it ALPHABETIC
+it b
+it a
+it zebra
+it alphabetically
+it Zebra
+option sortkernel 2
+sort
+rh a
+option compare 1
+sort
+rh ALPHABETIC
+rh Alpha
+rh Zebra
+rh alpha
+rh alphabet
+rh alphabetic
+option compare 3
+sort
+rh zebra
+rh b
+rh alphabetically
+rh alphabetical
+free
+# Random strings with long shared prefixes under all byte-order comparators
+option compare 0
+new
+it RAND 500
+ih dolphindolphin 100
+ih dolphindolphins 50
+ih DolphinDolphin 50
+it dolphin 30
+sort
+option compare 1
+sort
+option sortkernel 1
+option compare 2
+sort
+option compare 3
+sort
+option sortkernel 0
+option compare 1
+sort
+option sortkernel 2
+option compare 0
+sort
+rhq 730
+free
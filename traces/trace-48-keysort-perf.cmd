@@ -0,0 +1,24 @@
+# Test performance of sorting by key prefixes against merging lists
+option fail 0
+option malloc 0
+option sortkernel 0
+new
+it RAND 300000
+time sort
+free
+option sortkernel 1
+new
+it RAND 300000
+time sort
+free
+option sortkernel 2
+new
+it RAND 300000
+time sort
+free
+option compare 1
+new
+it RAND 300000
+time sort
+free
+option compare 0
@@ -0,0 +1,80 @@
+# Test of access by position through a segment index
+option fail 0
+option malloc 0
+option segments 3
+new
+it c
+it d
+it e
+ih b
+ih a
+it f
+it g
+at 0 a
+at 3 d
+at 6 g
+at 7
+rh a
+rh b
+at 0 c
+at 4 g
+ih b
+ih a
+at 1 b
+at 5 f
+reverse
+at 0 g
+at 6 a
+sort
+at 2 c
+at 6 g
+split 4 1
+show
+at 3 d
+it h
+at 4 h
+option queue 1
+show
+at 0 e
+at 2 g
+free
+option queue 0
+# Splitting at both ends
+split 0 1
+show
+option queue 1
+at 0 a
+split 5 0
+show
+split 2 2
+show
+option queue 2
+at 0 c
+at 2 h
+free
+option queue 1
+free
+option queue 0
+free
+option segments 0
+# Bounded queue keeps its index without allocating
+option segments 2
+new 6 8
+it a
+it b
+it c
+it d
+ih z
+at 4 d
+reverse
+at 1 c
+rh d
+option overwrite 1
+it e
+it f
+it g
+at 0 b
+at 5 g
+free
+option overwrite 0
+option segments 0
@@ -0,0 +1,30 @@
+# Test performance of keeping a segment index
+option fail 0
+option malloc 0
+new
+time it RAND 300000
+time ih RAND 300000
+mem
+time rhq 300000
+free
+option segments 64
+new
+time it RAND 300000
+time ih RAND 300000
+mem
+time rhq 300000
+mem
+it dolphin
+time at 300000 dolphin
+reverse
+time at 0 dolphin
+time at 300000
+time at 150000
+time split 150000 1
+time at 149999
+option queue 1
+time at 150000
+free
+option queue 0
+free
+option segments 0
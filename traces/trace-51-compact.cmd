@@ -0,0 +1,52 @@
+# Test of laying out elements contiguously in list order
+option fail 0
+option malloc 0
+new
+it gerbil
+it bear
+it dolphin
+ih meerkat
+ih vulture
+it aardvark
+compact 2
+show
+sort
+compact
+show
+rh aardvark
+ih zebra
+it yak
+compact 3
+reverse
+compact 1
+show
+rh yak
+option index 1
+it gerbil
+dedup hash
+count gerbil 1
+compact
+count gerbil 1
+option index 0
+option segments 2
+at 2 gerbil
+compact 2
+at 2 gerbil
+option segments 0
+# Compacting around a spilled middle
+option spill 4
+it cat 6
+compact
+rhq 7
+rh cat
+option spill 0
+compact
+show
+free
+# Bounded queue is left alone
+new 4 8
+it a
+it b
+compact
+rh a
+free
@@ -0,0 +1,16 @@
+# Test performance of traversal before and after compaction
+option fail 0
+option malloc 0
+new
+it RAND 400000
+sort
+time count dolphin
+time reverse
+time reverse
+mem
+time compact 50000
+mem
+time count dolphin
+time reverse
+time reverse
+free
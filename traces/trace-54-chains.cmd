@@ -0,0 +1,82 @@
+# Test of walking several chains at once in reverse and free
+option fail 0
+option malloc 0
+option segments 2
+new
+it ff
+it gg
+it hh
+it ii
+it jj
+it kk
+it ll
+it mm
+it nn
+it oo
+it pp
+it qq
+it rr
+it ss
+it tt
+ih ee
+ih dd
+ih cc
+ih bb
+ih aa
+reverse
+at 0 tt
+at 7 mm
+at 19 aa
+rh tt
+rh ss
+it zz
+reverse
+at 0 zz
+at 1 aa
+at 18 rr
+free
+option segments 0
+# Split through the skip index of a sorted queue
+new
+is hh
+is dd
+is pp
+is aa
+is tt
+is ll
+is ff
+is nn
+is bb
+is rr
+is jj
+is cc
+is ss
+is gg
+is oo
+is kk
+is ee
+is qq
+is ii
+is mm
+reverse
+rh tt
+rh ss
+rh rr
+rh qq
+rh pp
+rh oo
+reverse
+rh aa
+rh bb
+size 12
+free
+# A single chain without an index
+new
+it x
+it y
+it z
+reverse
+rh z
+rh y
+rh x
+free
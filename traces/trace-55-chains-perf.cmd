@@ -0,0 +1,17 @@
+# Test performance of walking several chains at once
+option fail 0
+option malloc 0
+option segments 64
+new
+it RAND 1000000
+sort
+at 1
+time reverse
+at 1
+time free
+option segments 0
+new
+it RAND 1000000
+sort
+time reverse
+time free
@@ -0,0 +1,34 @@
+# Test of freeing queues in the background
+option fail 0
+option malloc 0
+new
+it RAND 500000
+time free async
+new
+it gerbil
+ih dolphin
+it RAND 1000
+option queue 1
+new
+it bear
+option segments 4
+option queue 2
+new
+it RAND 200000
+reverse
+time free async
+option queue 1
+free async
+option queue 0
+size 1002
+rh dolphin
+free async
+time drain
+mem
+new
+it meerkat
+option queue 3
+new
+it RAND 100000
+option queue 0
+option segments 0
@@ -0,0 +1,50 @@
+# Test of allocating elements from regions of huge pages
+option fail 0
+option malloc 0
+option hugepages 1
+new
+it gerbil
+it bear
+ih dolphin
+it meerkat
+ih vulture
+show
+sort
+show
+reverse
+rh vulture
+rh meerkat
+it RAND 100000
+rhq 50000
+option queue 1
+new
+option queue 0
+split 10000 1
+compact
+option hugepages 0
+it aardvark
+ih zebra
+rh zebra
+dedup hash
+free
+option queue 1
+rhq 40003
+free
+option queue 0
+# Reserved huge pages, or transparent ones when none is reserved
+option hugepages 2
+new
+it RAND 70000
+it yak
+ih ant
+rh ant
+sort
+reverse
+free
+# Bounded queues keep their own storage
+new 4 8
+it one
+it two
+rh one
+free
+option hugepages 0
@@ -0,0 +1,19 @@
+# Test performance of allocating elements from huge pages
+option fail 0
+option malloc 0
+option hugepages 1
+new
+it RAND 1000000
+mem
+time reverse
+time sort
+time reverse
+time free
+option hugepages 0
+new
+it RAND 1000000
+mem
+time reverse
+time sort
+time reverse
+time free
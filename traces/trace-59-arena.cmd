@@ -0,0 +1,40 @@
+# Test of queue with elements in an arena
+option fail 0
+option malloc 0
+anew
+ait gerbil
+ait bear
+aih dolphin
+ait hippopotamus
+aih elevenchars
+aih twelve_chars
+ait a
+arh twelve_chars
+arh elevenchars
+areverse
+arh a
+arh hippopotamus
+ait vulture
+ait rhinoceroses
+asort
+arh bear
+arh dolphin
+arh gerbil
+arh rhinoceroses
+arh vulture
+# Slots of removed elements are taken again before the arena grows
+ait meerkat 20
+ait crocodile_of_the_nile 20
+aih yak 10
+asort
+areverse
+arh yak
+mem
+afree
+anew
+ait RAND 10000
+asort
+areverse
+aih zebra
+arh zebra
+afree
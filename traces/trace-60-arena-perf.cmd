@@ -0,0 +1,17 @@
+# Test performance of queue with elements in an arena
+option fail 0
+option malloc 0
+new
+time ih dolphin 1000000
+time it gerbil 1000000
+mem
+time reverse
+time sort
+free
+anew
+time aih dolphin 1000000
+time ait gerbil 1000000
+mem
+time areverse
+time asort
+afree
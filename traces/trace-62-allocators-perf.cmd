@@ -0,0 +1,38 @@
+# Test performance of queues on each allocator
+option fail 0
+option malloc 0
+option alloctrack 0
+option allocator 0
+new
+time ih dolphin 1000000
+time it RAND 500000
+time sort
+time rhq 1000000
+time reverse
+time free
+option allocator 1
+new
+time ih dolphin 1000000
+time it RAND 500000
+time sort
+time rhq 1000000
+time reverse
+time free
+option allocator 2
+new
+time ih dolphin 1000000
+time it RAND 500000
+time sort
+time rhq 1000000
+time reverse
+time free
+option allocator 3
+new
+time ih dolphin 1000000
+time it RAND 500000
+time sort
+time rhq 1000000
+time reverse
+time free
+option alloctrack 1
+option allocator 0
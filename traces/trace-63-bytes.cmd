@@ -0,0 +1,157 @@
+# Test of values holding any bytes, zeros included
+option fail 0
+option malloc 0
+new
+itx 610062
+itx 61
+ihx 6100
+itx -
+itx 00
+ih b
+peek 62
+rhx 62
+it a
+rh a
+rhx 610062
+peek 61
+# Byte order puts shorter values before longer ones they start
+option compare 1
+sort
+rhx -
+rhx 00
+peek 61
+option sortkernel 0
+itx 0000
+ihx 610000
+sort
+rhx 0000
+rhx 61
+rhx 61
+rhx 610000
+# Merging lists, the heap of the top elements and the loser tree agree
+it RAND 2000
+itx 7a7a7a7a7a7a7a7a7a7a7a7a00
+itx 7a7a7a7a7a7a7a7a7a7a7a7a
+itx 7a7a7a7a7a7a7a7a7a7a7a7a0000
+option compare 3
+sort
+rhx 7a7a7a7a7a7a7a7a7a7a7a7a0000
+rhx 7a7a7a7a7a7a7a7a7a7a7a7a00
+rhx 7a7a7a7a7a7a7a7a7a7a7a7a
+option sortkernel 2
+option compare 1
+ihx 0102
+itx 01020000000000000003
+itx 010200
+sort
+rhx 0102
+rhx 010200
+rhx 01020000000000000003
+free
+# Case-insensitive order ends values at their first zero byte, and ties keep
+# their order in the scalar merge of keys
+option compare 0
+option sortkernel 1
+new
+itx 610062
+itx 41006100
+itx 61
+itx 42
+itx 6100
+sort
+rhx 610062
+rhx 41006100
+rhx 61
+rhx 6100
+rhx 42
+free
+option compare 2
+option sortkernel 1
+new
+itx 610062
+itx 41006100
+itx 61
+itx 42
+itx 6100
+sort
+rhx 42
+rhx 610062
+rhx 41006100
+rhx 61
+rhx 6100
+free
+option sortkernel 2
+option compare 1
+# Grouping and deduplication by hashing both compare values as strings
+new
+itx 610062
+itx 62
+itx 610063
+itx 61
+group
+rhx 610062
+rhx 610063
+rhx 61
+rhx 62
+itx 610062
+itx 62
+itx 610063
+itx 61
+dedup hash
+rhx 610062
+rhx 62
+free
+# Bounded queues keep at most their maximum length
+new 2 3
+itx 6162006465
+itx 00
+rhx 616200
+rhx 00
+free
+# Spilled and compacted elements keep their lengths
+option spill 10
+new
+itx 0a000b 100
+it gerbil 100
+ihx 0c0d00
+rhx 0c0d00
+rhx 0a000b
+compact
+peek 0a000b
+rhq 98
+peek 0a000b
+rhx 0a000b
+rh gerbil
+free
+option spill 0
+# Sorted insertion and lower bounds order values holding zeros by bytes
+option compare 1
+new
+itx 62
+itx 610062
+itx 6100
+itx 40
+sort
+is a
+rhx 40
+rhx 61
+rhx 6100
+rhx 610062
+rhx 62
+free
+option compare 3
+new
+itx 62
+itx 610062
+itx 6100
+itx 40
+sort
+lb a @
+is c
+lb a @
+rh c
+rhx 62
+rhx 610062
+rhx 6100
+rhx 40
+free
@@ -0,0 +1,20 @@
+# Test of a queue of more than 2^31 elements, spilling all but a few of them
+# to a file of about 22 gigabytes. It takes about 15 minutes, so the driver
+# does not run it; run
+#     ./qtest -f traces/trace-huge.cmd
+option fail 0
+option malloc 0
+option timelimit 0
+option spill 1000000
+new
+it a 2200000000
+ih b
+it c
+size 2147483648
+rh b
+rhq 2200000000
+rh c
+size
+free
+option spill 0
+option timelimit 1
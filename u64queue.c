@@ -0,0 +1,9 @@
+#include <stdlib.h>
+
+#include "harness.h"
+#include "u64queue.h"
+
+/* Compare in ascending order without overflow */
+#define U64_CMP(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+
+QUEUE_DEFINE(u64q, uint64_t, U64_CMP)
@@ -0,0 +1,15 @@
+#ifndef LAB0_U64QUEUE_H
+#define LAB0_U64QUEUE_H
+
+/*
+ * This program instantiates a queue of 64-bit unsigned integers with the
+ * generator of tqueue.h.
+ */
+
+#include <stdint.h>
+
+#include "tqueue.h"
+
+QUEUE_DECLARE(u64q, uint64_t)
+
+#endif /* LAB0_U64QUEUE_H */